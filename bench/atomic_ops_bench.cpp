@@ -0,0 +1,247 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// A small self-contained benchmark for the atomic_ops primitives.
+//
+//   atomic_ops_bench [iterations] [max threads]
+//
+// Results are written to stdout as CSV with one row per measurement. The
+// `unit` column says what `ops` counts: atomic operations for the primitive
+// rows, bits scanned for the bitmap scan rows.
+#include <atomic_ops/atomic_ops.hpp>
+#include <atomic_ops/bitmap_ops.hpp>
+#include <atomic_ops/bitmap_view.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace atomic_ops;
+
+namespace {
+using bench_clock = std::chrono::steady_clock;
+
+double elapsed(bench_clock::time_point start) {
+  return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+template <typename T>
+void do_not_optimize(T& t) {
+  asm volatile("" : "+m"(t) : : "memory");
+}
+
+constexpr const char* model_name(MemoryModel mm) {
+  switch (mm) {
+   case SequentialConsistency: return "sc";
+   case ReleaseConsistency:    return "rc";
+   case RelaxedConsistency:    return "xc";
+   case Unsynchronized:        return "unsync";
+  };
+  __builtin_unreachable();
+}
+
+template <typename T>
+constexpr const char* type_name() {
+  return (sizeof(T) == 4) ? "u32" : "u64";
+}
+
+void report(const char* bench, const char* mode, MemoryModel mm,
+            const char* type, unsigned threads, std::size_t ops,
+            const char* unit, double seconds) {
+  std::printf("%s,%s,%s,%s,%u,%zu,%s,%.6f,%.3f,%.3f\n", bench, mode,
+              model_name(mm), type, threads, ops, unit, seconds,
+              seconds * 1e9 * threads / ops, ops / seconds / 1e6);
+}
+
+template <typename T>
+struct alignas(CACHELINE_BYTES) slot {
+  T value = 0;
+};
+
+/// Run `op` `n` times on each of `threads` threads, either all on the same
+/// word (contended) or each on its own cacheline (private).
+template <MemoryModel MM, typename T, typename Op>
+void run_op(const char* bench, Op op, mm_tag<MM> mm, unsigned threads,
+            bool shared, std::size_t n) {
+  std::vector<slot<T>> slots(threads);
+  std::vector<double> seconds(threads);
+  std::vector<std::thread> workers;
+  unsigned ready = 0;
+
+  for (unsigned i = 0; i < threads; ++i) {
+    workers.emplace_back([&, i] {
+      T& t = slots[shared ? 0 : i].value;
+      fetch_add(ready, 1, sc);
+      while (load(ready, sc) < threads) {
+      }
+      auto start = bench_clock::now();
+      for (std::size_t j = 0; j < n; ++j) {
+        op(t, mm);
+      }
+      seconds[i] = elapsed(start);
+    });
+  }
+
+  double max = 0;
+  for (unsigned i = 0; i < threads; ++i) {
+    workers[i].join();
+    max = (seconds[i] < max) ? max : seconds[i];
+  }
+
+  report(bench, shared ? "shared" : "private", MM, type_name<T>(), threads,
+         n * threads, "op", max);
+}
+
+template <MemoryModel MM, typename T>
+void run_ops(mm_tag<MM> mm, unsigned threads, bool shared, std::size_t n) {
+  run_op<MM, T>("load", [](T& t, auto mm) {
+    T v = load(t, mm);
+    do_not_optimize(v);
+  }, mm, threads, shared, n);
+
+  run_op<MM, T>("store", [](T& t, auto mm) {
+    store(t, T(1), mm);
+    do_not_optimize(t);
+  }, mm, threads, shared, n);
+
+  run_op<MM, T>("exchange", [](T& t, auto mm) {
+    T v = exchange(t, T(1), mm);
+    do_not_optimize(v);
+  }, mm, threads, shared, n);
+
+  run_op<MM, T>("fetch_add", [](T& t, auto mm) {
+    T v = fetch_add(t, T(1), mm);
+    do_not_optimize(v);
+  }, mm, threads, shared, n);
+
+  run_op<MM, T>("fetch_or", [](T& t, auto mm) {
+    T v = fetch_or(t, T(1), mm);
+    do_not_optimize(v);
+  }, mm, threads, shared, n);
+
+  run_op<MM, T>("fetch_max", [](T& t, auto mm) {
+    T v = fetch_max(t, T(-1), mm);
+    do_not_optimize(v);
+  }, mm, threads, shared, n);
+
+  run_op<MM, T>("compare_exchange", [](T& t, auto mm) {
+    T e = load(t, mm);
+    bool v = compare_exchange_strong(t, e, T(e + 1), mm);
+    do_not_optimize(v);
+  }, mm, threads, shared, n);
+}
+
+template <MemoryModel MM, typename T>
+void run_model(mm_tag<MM> mm, unsigned max_threads, std::size_t n) {
+  for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+    run_ops<MM, T>(mm, threads, false, n);
+    // Unsynchronized operations on a shared word would be a data race.
+    if (MM != Unsynchronized || threads == 1) {
+      run_ops<MM, T>(mm, threads, true, n);
+    }
+  }
+}
+
+/// Time a full scan of an `n`-bit bitmap with the given density of set bits.
+/// Each scan counts the set bits it finds and is reported per bit scanned.
+template <MemoryModel MM>
+void run_scan(mm_tag<MM> mm, double density, std::size_t n) {
+  std::vector<unsigned long> bits(bitmap_words(n));
+  std::mt19937_64 gen(42);
+  std::bernoulli_distribution coin(density);
+  for (std::size_t i = 0; i < n; ++i) {
+    if (coin(gen)) {
+      bitmap_set(bits.data(), i, unsync);
+    }
+  }
+
+  char name[64];
+
+  std::snprintf(name, sizeof(name), "bitmap_next/%g", density);
+  auto start = bench_clock::now();
+  std::size_t found = 0;
+  for (auto i = bitmap_first(bits.data(), std::size_t(0), n, mm); i < n;
+       i = bitmap_next(bits.data(), i, n, mm)) {
+    ++found;
+  }
+  do_not_optimize(found);
+  double seconds = elapsed(start);
+  report(name, "scan", MM, "bitmap", 1, n, "bit", seconds);
+
+  std::snprintf(name, sizeof(name), "bitmap_view/%g", density);
+  start = bench_clock::now();
+  found = 0;
+  for ([[maybe_unused]] auto i : bitmap_view(bits.data(), std::size_t(0), n,
+                                             mm)) {
+    ++found;
+  }
+  do_not_optimize(found);
+  seconds = elapsed(start);
+  report(name, "scan", MM, "bitmap", 1, n, "bit", seconds);
+
+  std::snprintf(name, sizeof(name), "bitmap_count/%g", density);
+  start = bench_clock::now();
+  found = bitmap_count(bits.data(), std::size_t(0), n, mm);
+  do_not_optimize(found);
+  seconds = elapsed(start);
+  report(name, "scan", MM, "bitmap", 1, n, "bit", seconds);
+}
+
+template <MemoryModel MM>
+void run_all(mm_tag<MM> mm, unsigned max_threads, std::size_t n) {
+  run_model<MM, std::uint32_t>(mm, max_threads, n);
+  run_model<MM, std::uint64_t>(mm, max_threads, n);
+  for (double density : {0.5, 0.1, 0.01, 0.001, 0.0001}) {
+    run_scan(mm, density, 64 * n);
+  }
+}
+}
+
+int main(int argc, char* argv[]) {
+  std::size_t n = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 1 << 20;
+  unsigned max_threads = (argc > 2) ? std::atoi(argv[2])
+                                    : std::thread::hardware_concurrency();
+  if (n == 0 || max_threads == 0) {
+    std::fprintf(stderr, "usage: %s [iterations] [max threads]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::printf("benchmark,mode,model,type,threads,ops,unit,seconds,"
+              "ns_per_op,mops\n");
+  run_all(sc, max_threads, n);
+  run_all(rc, max_threads, n);
+  run_all(xc, max_threads, n);
+  run_all(unsync, max_threads, n);
+  return EXIT_SUCCESS;
+}
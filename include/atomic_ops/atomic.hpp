@@ -0,0 +1,202 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include "atomic_ops.hpp"
+
+namespace atomic_ops {
+/// A reference to a `T` that is always accessed with the memory model `MM`.
+///
+/// Each member forwards to the corresponding free function with `mm_tag<MM>`,
+/// so it compiles to the same code as the tagged call.
+template <typename T, MemoryModel MM = ReleaseConsistency>
+class ref {
+  T* t_;
+
+ public:
+  using value_type = T;
+  static constexpr mm_tag<MM> mm = {};
+
+  constexpr explicit ref(T& t) : t_(std::addressof(t)) {
+  }
+
+  T load() const {
+    return atomic_ops::load(*t_, mm);
+  }
+
+  template <typename U>
+  void store(U u) const {
+    atomic_ops::store(*t_, u, mm);
+  }
+
+  template <typename U>
+  T exchange(U u) const {
+    return atomic_ops::exchange(*t_, u, mm);
+  }
+
+  template <typename U>
+  bool compare_exchange_weak(T& expected, U desired) const {
+    return atomic_ops::compare_exchange_weak(*t_, expected, desired, mm);
+  }
+
+  template <typename U>
+  bool compare_exchange_strong(T& expected, U desired) const {
+    return atomic_ops::compare_exchange_strong(*t_, expected, desired, mm);
+  }
+
+  template <typename U>
+  T fetch_add(U u) const {
+    return atomic_ops::fetch_add(*t_, u, mm);
+  }
+
+  template <typename U>
+  T fetch_and(U u) const {
+    return atomic_ops::fetch_and(*t_, u, mm);
+  }
+
+  template <typename U>
+  T fetch_or(U u) const {
+    return atomic_ops::fetch_or(*t_, u, mm);
+  }
+
+  template <typename U>
+  T fetch_sub(U u) const {
+    return atomic_ops::fetch_sub(*t_, u, mm);
+  }
+
+  template <typename U>
+  T fetch_xor(U u) const {
+    return atomic_ops::fetch_xor(*t_, u, mm);
+  }
+
+  template <typename U>
+  T fetch_nand(U u) const {
+    return atomic_ops::fetch_nand(*t_, u, mm);
+  }
+
+  template <typename U>
+  T fetch_min(U u) const {
+    return atomic_ops::fetch_min(*t_, u, mm);
+  }
+
+  template <typename U>
+  T fetch_max(U u) const {
+    return atomic_ops::fetch_max(*t_, u, mm);
+  }
+};
+
+/// A `T` that is always accessed with the memory model `MM`.
+template <typename T, MemoryModel MM = ReleaseConsistency>
+class atomic {
+  T t_;
+
+  constexpr ref<T, MM> self() const {
+    return ref<T, MM>(const_cast<T&>(t_));
+  }
+
+ public:
+  using value_type = T;
+  static constexpr mm_tag<MM> mm = {};
+
+  constexpr atomic() : t_() {
+  }
+
+  constexpr explicit atomic(T t) : t_(t) {
+  }
+
+  atomic(const atomic&) = delete;
+  atomic& operator=(const atomic&) = delete;
+
+  T load() const {
+    return self().load();
+  }
+
+  template <typename U>
+  void store(U u) {
+    self().store(u);
+  }
+
+  template <typename U>
+  T exchange(U u) {
+    return self().exchange(u);
+  }
+
+  template <typename U>
+  bool compare_exchange_weak(T& expected, U desired) {
+    return self().compare_exchange_weak(expected, desired);
+  }
+
+  template <typename U>
+  bool compare_exchange_strong(T& expected, U desired) {
+    return self().compare_exchange_strong(expected, desired);
+  }
+
+  template <typename U>
+  T fetch_add(U u) {
+    return self().fetch_add(u);
+  }
+
+  template <typename U>
+  T fetch_and(U u) {
+    return self().fetch_and(u);
+  }
+
+  template <typename U>
+  T fetch_or(U u) {
+    return self().fetch_or(u);
+  }
+
+  template <typename U>
+  T fetch_sub(U u) {
+    return self().fetch_sub(u);
+  }
+
+  template <typename U>
+  T fetch_xor(U u) {
+    return self().fetch_xor(u);
+  }
+
+  template <typename U>
+  T fetch_nand(U u) {
+    return self().fetch_nand(u);
+  }
+
+  template <typename U>
+  T fetch_min(U u) {
+    return self().fetch_min(u);
+  }
+
+  template <typename U>
+  T fetch_max(U u) {
+    return self().fetch_max(u);
+  }
+};
+}
@@ -30,9 +30,24 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #pragma once
 
+#include <bit>
+#include <cstdint>
 #include <memory>
+#include <type_traits>
+
+#if defined(ATOMIC_OPS_INSTRUMENT)
+#include "instrument.hpp"
+#else
+#define ATOMIC_OPS_SITE
+#define ATOMIC_OPS_SITE_ARG
+#define ATOMIC_OPS_PROBE(op, mm)
+#define ATOMIC_OPS_CAS(ok) (ok)
+#endif
 
 namespace atomic_ops {
+/// The cacheline size assumed for padding and prefetching.
+static constexpr int CACHELINE_BYTES = 64;
+
 enum memory_order : int {
   acquire = __ATOMIC_ACQUIRE,
   relaxed = __ATOMIC_RELAXED,
@@ -66,6 +81,100 @@ constexpr T fetch_or(T& t, U u, memory_order order) {
   return __atomic_fetch_or(std::addressof(t), u, order);
 }
 
+template <typename T, typename U>
+constexpr T fetch_sub(T& t, U u, memory_order order) {
+  return __atomic_fetch_sub(std::addressof(t), u, order);
+}
+
+template <typename T, typename U>
+constexpr T fetch_xor(T& t, U u, memory_order order) {
+  return __atomic_fetch_xor(std::addressof(t), u, order);
+}
+
+template <typename T, typename U>
+constexpr T fetch_nand(T& t, U u, memory_order order) {
+  return __atomic_fetch_nand(std::addressof(t), u, order);
+}
+
+template <typename T, typename U>
+constexpr T exchange(T& t, U u, memory_order order) {
+  return __atomic_exchange_n(std::addressof(t), u, order);
+}
+
+template <typename T, typename U>
+constexpr bool compare_exchange_weak(T& t, T& expected, U desired,
+                                     memory_order success,
+                                     memory_order failure) {
+  return __atomic_compare_exchange_n(std::addressof(t),
+                                     std::addressof(expected), desired, true,
+                                     success, failure);
+}
+
+template <typename T, typename U>
+constexpr bool compare_exchange_strong(T& t, T& expected, U desired,
+                                       memory_order success,
+                                       memory_order failure) {
+  return __atomic_compare_exchange_n(std::addressof(t),
+                                     std::addressof(expected), desired, false,
+                                     success, failure);
+}
+
+/// The strongest failure order that is valid for a given success order.
+static constexpr memory_order failure_order(memory_order order) {
+  switch (order) {
+   case acq_rel: return acquire;
+   case release: return relaxed;
+   default:      return order;
+  };
+}
+
+// __has_builtin is tested on its own first because an #if that names it is
+// ill-formed on preprocessors that do not define it. Defining
+// ATOMIC_OPS_CAS_MIN_MAX selects the CAS loops even where the builtins exist,
+// which lets the tests check that both paths agree.
+#if defined(__has_builtin) && !defined(ATOMIC_OPS_CAS_MIN_MAX)
+#if __has_builtin(__atomic_fetch_min)
+#define ATOMIC_OPS_HAS_FETCH_MIN
+#endif
+#if __has_builtin(__atomic_fetch_max)
+#define ATOMIC_OPS_HAS_FETCH_MAX
+#endif
+#endif
+
+// `u` is converted to T before it is compared, as the builtins do, so that a
+// mix of signed and unsigned operands compares the values that are stored.
+template <typename T, typename U>
+constexpr T fetch_min(T& t, U u, memory_order order) {
+  T v = static_cast<T>(u);
+#if defined(ATOMIC_OPS_HAS_FETCH_MIN)
+  return __atomic_fetch_min(std::addressof(t), v, order);
+#else
+  T temp = load(t, failure_order(order));
+  while (v < temp && !compare_exchange_weak(t, temp, v, order,
+                                            failure_order(order))) {
+  }
+  return temp;
+#endif
+}
+
+template <typename T, typename U>
+constexpr T fetch_max(T& t, U u, memory_order order) {
+  T v = static_cast<T>(u);
+#if defined(ATOMIC_OPS_HAS_FETCH_MAX)
+  return __atomic_fetch_max(std::addressof(t), v, order);
+#else
+  T temp = load(t, failure_order(order));
+  while (temp < v && !compare_exchange_weak(t, temp, v, order,
+                                            failure_order(order))) {
+  }
+  return temp;
+#endif
+}
+
+inline void thread_fence(memory_order order) {
+  __atomic_thread_fence(order);
+}
+
 enum MemoryModel {
   SequentialConsistency,
   ReleaseConsistency,
@@ -115,8 +224,42 @@ static constexpr memory_order rmw_order(MemoryModel mm) {
   __builtin_unreachable();
 }
 
+// The orders that each model maps to, pinned so that an edit to the tables
+// above cannot silently strengthen a relaxed model into fenced instructions,
+// or weaken an ordered one. The failure orders are those of the tagged CAS.
+// What the compiler lowers each order to is checked by tests/codegen.cpp.
+static_assert(load_order(SequentialConsistency) == seq_cst);
+static_assert(load_order(ReleaseConsistency) == acquire);
+static_assert(load_order(RelaxedConsistency) == relaxed);
+static_assert(load_order(Unsynchronized) == relaxed);
+static_assert(store_order(SequentialConsistency) == seq_cst);
+static_assert(store_order(ReleaseConsistency) == release);
+static_assert(store_order(RelaxedConsistency) == relaxed);
+static_assert(store_order(Unsynchronized) == relaxed);
+static_assert(rmw_order(SequentialConsistency) == seq_cst);
+static_assert(rmw_order(ReleaseConsistency) == acq_rel);
+static_assert(rmw_order(RelaxedConsistency) == relaxed);
+static_assert(rmw_order(Unsynchronized) == relaxed);
+static_assert(failure_order(seq_cst) == seq_cst);
+static_assert(failure_order(acq_rel) == acquire);
+static_assert(failure_order(release) == relaxed);
+static_assert(failure_order(relaxed) == relaxed);
+
+/// Issue a fence with the rmw order of the model.
+///
+/// RelaxedConsistency and Unsynchronized have no ordering, so this is a no-op
+/// for them.
+template <MemoryModel mm>
+void thread_fence(mm_tag<mm> = {} ATOMIC_OPS_SITE) {
+  ATOMIC_OPS_PROBE("thread_fence", mm);
+  if constexpr (mm == SequentialConsistency || mm == ReleaseConsistency) {
+    thread_fence(rmw_order(mm));
+  }
+}
+
 template <MemoryModel mm, typename T>
-constexpr T load(T& t, mm_tag<mm> = {}) {
+constexpr T load(T& t, mm_tag<mm> = {} ATOMIC_OPS_SITE) {
+  ATOMIC_OPS_PROBE("load", mm);
   if constexpr (mm == Unsynchronized) {
     return t;
   }
@@ -126,7 +269,8 @@ constexpr T load(T& t, mm_tag<mm> = {}) {
 }
 
 template <MemoryModel mm, typename T, typename U>
-void store(T& t, U u, mm_tag<mm> = {}) {
+void store(T& t, U u, mm_tag<mm> = {} ATOMIC_OPS_SITE) {
+  ATOMIC_OPS_PROBE("store", mm);
   if constexpr (mm == Unsynchronized) {
     t = u;
   }
@@ -136,7 +280,8 @@ void store(T& t, U u, mm_tag<mm> = {}) {
 }
 
 template <MemoryModel mm, typename T, typename U>
-T fetch_add(T& t, U u, mm_tag<mm> = {}) {
+T fetch_add(T& t, U u, mm_tag<mm> = {} ATOMIC_OPS_SITE) {
+  ATOMIC_OPS_PROBE("fetch_add", mm);
   if constexpr (mm == Unsynchronized) {
     T temp = t;
     t = temp + u;
@@ -148,7 +293,8 @@ T fetch_add(T& t, U u, mm_tag<mm> = {}) {
 }
 
 template <MemoryModel mm, typename T, typename U>
-T fetch_and(T& t, U u, mm_tag<mm> = {}) {
+T fetch_and(T& t, U u, mm_tag<mm> = {} ATOMIC_OPS_SITE) {
+  ATOMIC_OPS_PROBE("fetch_and", mm);
   if constexpr (mm == Unsynchronized) {
     T temp = t;
     t = temp & u;
@@ -160,7 +306,8 @@ T fetch_and(T& t, U u, mm_tag<mm> = {}) {
 }
 
 template <MemoryModel mm, typename T, typename U>
-T fetch_or(T& t, U u, mm_tag<mm> = {}) {
+T fetch_or(T& t, U u, mm_tag<mm> = {} ATOMIC_OPS_SITE) {
+  ATOMIC_OPS_PROBE("fetch_or", mm);
   if constexpr (mm == Unsynchronized) {
     T temp = t;
     t = temp | u;
@@ -170,4 +317,286 @@ T fetch_or(T& t, U u, mm_tag<mm> = {}) {
     return fetch_or(t, u, rmw_order(mm));
   }
 }
+
+template <MemoryModel mm, typename T, typename U>
+T fetch_sub(T& t, U u, mm_tag<mm> = {} ATOMIC_OPS_SITE) {
+  ATOMIC_OPS_PROBE("fetch_sub", mm);
+  if constexpr (mm == Unsynchronized) {
+    T temp = t;
+    t = temp - u;
+    return temp;
+  }
+  else {
+    return fetch_sub(t, u, rmw_order(mm));
+  }
+}
+
+template <MemoryModel mm, typename T, typename U>
+T fetch_xor(T& t, U u, mm_tag<mm> = {} ATOMIC_OPS_SITE) {
+  ATOMIC_OPS_PROBE("fetch_xor", mm);
+  if constexpr (mm == Unsynchronized) {
+    T temp = t;
+    t = temp ^ u;
+    return temp;
+  }
+  else {
+    return fetch_xor(t, u, rmw_order(mm));
+  }
+}
+
+template <MemoryModel mm, typename T, typename U>
+T fetch_nand(T& t, U u, mm_tag<mm> = {} ATOMIC_OPS_SITE) {
+  ATOMIC_OPS_PROBE("fetch_nand", mm);
+  if constexpr (mm == Unsynchronized) {
+    T temp = t;
+    t = ~(temp & u);
+    return temp;
+  }
+  else {
+    return fetch_nand(t, u, rmw_order(mm));
+  }
+}
+
+/// Atomically replace `t` with `min(t, u)`.
+///
+/// This uses the native instruction when the compiler provides
+/// __atomic_fetch_min, and otherwise a weak CAS loop that exits without
+/// writing as soon as `t` is already no larger than `u`.
+template <MemoryModel mm, typename T, typename U>
+T fetch_min(T& t, U u, mm_tag<mm> = {} ATOMIC_OPS_SITE) {
+  ATOMIC_OPS_PROBE("fetch_min", mm);
+  if constexpr (mm == Unsynchronized) {
+    T temp = t;
+    T v = static_cast<T>(u);
+    if (v < temp) {
+      t = v;
+    }
+    return temp;
+  }
+  else {
+    return fetch_min(t, u, rmw_order(mm));
+  }
+}
+
+/// Atomically replace `t` with `max(t, u)`.
+///
+/// This uses the native instruction when the compiler provides
+/// __atomic_fetch_max, and otherwise a weak CAS loop that exits without
+/// writing as soon as `t` is already no smaller than `u`.
+template <MemoryModel mm, typename T, typename U>
+T fetch_max(T& t, U u, mm_tag<mm> = {} ATOMIC_OPS_SITE) {
+  ATOMIC_OPS_PROBE("fetch_max", mm);
+  if constexpr (mm == Unsynchronized) {
+    T temp = t;
+    T v = static_cast<T>(u);
+    if (temp < v) {
+      t = v;
+    }
+    return temp;
+  }
+  else {
+    return fetch_max(t, u, rmw_order(mm));
+  }
+}
+
+template <MemoryModel mm, typename T, typename U>
+T exchange(T& t, U u, mm_tag<mm> = {} ATOMIC_OPS_SITE) {
+  ATOMIC_OPS_PROBE("exchange", mm);
+  if constexpr (mm == Unsynchronized) {
+    T temp = t;
+    t = u;
+    return temp;
+  }
+  else {
+    return exchange(t, u, rmw_order(mm));
+  }
+}
+
+/// Compare-and-swap that may fail spuriously.
+///
+/// The success order is the model's rmw_order and the failure order is its
+/// load_order. On failure `expected` is updated with the observed value.
+template <MemoryModel mm, typename T, typename U>
+bool compare_exchange_weak(T& t, T& expected, U desired,
+                           mm_tag<mm> = {} ATOMIC_OPS_SITE) {
+  ATOMIC_OPS_PROBE("compare_exchange_weak", mm);
+  if constexpr (mm == Unsynchronized) {
+    if (t == expected) {
+      t = desired;
+      return ATOMIC_OPS_CAS(true);
+    }
+    expected = t;
+    return ATOMIC_OPS_CAS(false);
+  }
+  else {
+    return ATOMIC_OPS_CAS(compare_exchange_weak(t, expected, desired,
+                                                rmw_order(mm), load_order(mm)));
+  }
+}
+
+/// Compare-and-swap that only fails if `t != expected`.
+///
+/// The success order is the model's rmw_order and the failure order is its
+/// load_order. On failure `expected` is updated with the observed value.
+template <MemoryModel mm, typename T, typename U>
+bool compare_exchange_strong(T& t, T& expected, U desired,
+                             mm_tag<mm> = {} ATOMIC_OPS_SITE) {
+  ATOMIC_OPS_PROBE("compare_exchange_strong", mm);
+  if constexpr (mm == Unsynchronized) {
+    if (t == expected) {
+      t = desired;
+      return ATOMIC_OPS_CAS(true);
+    }
+    expected = t;
+    return ATOMIC_OPS_CAS(false);
+  }
+  else {
+    return ATOMIC_OPS_CAS(compare_exchange_strong(t, expected, desired,
+                                                  rmw_order(mm),
+                                                  load_order(mm)));
+  }
+}
+
+__extension__ using wide_word = unsigned __int128;
+
+/// A type that is accessed with the double-width (16 byte) operations.
+template <typename T>
+concept wide_atomic = sizeof(T) == 16 && std::is_trivially_copyable_v<T>;
+
+/// A strong 16 byte compare-and-swap that always uses the hardware.
+///
+/// On x86-64 this is `lock cmpxchg16b`, which requires -mcx16. On AArch64 it
+/// is `caspal` with LSE, and otherwise an `ldaxp`/`stlxp` loop, which stores
+/// back the observed value on failure so that the read is single-copy atomic.
+/// Both are at least as strong as acq_rel, so they satisfy every model. The
+/// memory must be writable, even when it is only loaded, and 16 byte aligned,
+/// since every one of these instructions faults on a misaligned address, so
+/// a pair of 8 byte fields needs `alignas(16)`.
+template <typename T>
+bool wide_compare_exchange(T& t, T& expected, T desired) {
+  static_assert(sizeof(T) == 16);
+  static_assert(alignof(T) >= 16,
+                "16 byte atomics need a 16 byte aligned type, use alignas(16)");
+  auto* p = reinterpret_cast<wide_word*>(std::addressof(t));
+  auto e = std::bit_cast<wide_word>(expected);
+  auto d = std::bit_cast<wide_word>(desired);
+#if defined(__x86_64__)
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+  auto o = __sync_val_compare_and_swap(p, e, d);
+#else
+  static_assert(sizeof(T) == 0, "16 byte atomics require -mcx16");
+  wide_word o = 0;
+#endif
+#elif defined(__aarch64__)
+  std::uint64_t lo, hi;
+#if defined(__ARM_FEATURE_ATOMICS)
+  register std::uint64_t x0 asm("x0") = std::uint64_t(e);
+  register std::uint64_t x1 asm("x1") = std::uint64_t(e >> 64);
+  register std::uint64_t x2 asm("x2") = std::uint64_t(d);
+  register std::uint64_t x3 asm("x3") = std::uint64_t(d >> 64);
+  asm volatile("caspal %0, %1, %3, %4, %2"
+               : "+r"(x0), "+r"(x1), "+Q"(*p)
+               : "r"(x2), "r"(x3)
+               : "memory");
+  lo = x0;
+  hi = x1;
+#else
+  std::uint32_t fail;
+  asm volatile("1: ldaxp %0, %1, %3\n"
+               "   cmp %0, %4\n"
+               "   ccmp %1, %5, #0, eq\n"
+               "   b.ne 2f\n"
+               "   stlxp %w2, %6, %7, %3\n"
+               "   cbnz %w2, 1b\n"
+               "   b 3f\n"
+               "2: stlxp %w2, %0, %1, %3\n"
+               "   cbnz %w2, 1b\n"
+               "3:"
+               : "=&r"(lo), "=&r"(hi), "=&r"(fail), "+Q"(*p)
+               : "r"(std::uint64_t(e)), "r"(std::uint64_t(e >> 64)),
+                 "r"(std::uint64_t(d)), "r"(std::uint64_t(d >> 64))
+               : "cc", "memory");
+#endif
+  auto o = wide_word(hi) << 64 | lo;
+#else
+  static_assert(sizeof(T) == 0, "16 byte atomics are not supported");
+  wide_word o = 0;
+#endif
+  if (o == e) {
+    return true;
+  }
+  expected = std::bit_cast<T>(o);
+  return false;
+}
+
+template <MemoryModel mm, wide_atomic T>
+T load(T& t, mm_tag<mm> = {} ATOMIC_OPS_SITE) {
+  ATOMIC_OPS_PROBE("load", mm);
+  if constexpr (mm == Unsynchronized) {
+    return t;
+  }
+  else {
+    static_assert(!std::is_const_v<T>,
+                  "16 byte atomic loads are a CAS and need writable memory");
+    auto e = std::bit_cast<T>(wide_word(0));
+    wide_compare_exchange(t, e, e);
+    return e;
+  }
+}
+
+template <MemoryModel mm, wide_atomic T, typename U>
+void store(T& t, U u, mm_tag<mm> = {} ATOMIC_OPS_SITE) {
+  ATOMIC_OPS_PROBE("store", mm);
+  if constexpr (mm == Unsynchronized) {
+    t = u;
+  }
+  else {
+    // Guess zero rather than reading `t` with plain loads, which could tear.
+    // If the guess is wrong the failed CAS is the single atomic read.
+    auto e = std::bit_cast<T>(wide_word(0));
+    while (!ATOMIC_OPS_CAS(wide_compare_exchange(t, e, T(u)))) {
+    }
+  }
+}
+
+template <MemoryModel mm, wide_atomic T, typename U>
+T exchange(T& t, U u, mm_tag<mm> = {} ATOMIC_OPS_SITE) {
+  ATOMIC_OPS_PROBE("exchange", mm);
+  if constexpr (mm == Unsynchronized) {
+    T temp = t;
+    t = u;
+    return temp;
+  }
+  else {
+    auto e = std::bit_cast<T>(wide_word(0));  // as in store
+    while (!ATOMIC_OPS_CAS(wide_compare_exchange(t, e, T(u)))) {
+    }
+    return e;
+  }
+}
+
+template <MemoryModel mm, wide_atomic T, typename U>
+bool compare_exchange_weak(T& t, T& expected, U desired,
+                           mm_tag<mm> = {} ATOMIC_OPS_SITE) {
+  return compare_exchange_strong(t, expected, desired,
+                                 mm_tag<mm>{} ATOMIC_OPS_SITE_ARG);
+}
+
+template <MemoryModel mm, wide_atomic T, typename U>
+bool compare_exchange_strong(T& t, T& expected, U desired,
+                             mm_tag<mm> = {} ATOMIC_OPS_SITE) {
+  ATOMIC_OPS_PROBE("compare_exchange_strong", mm);
+  if constexpr (mm == Unsynchronized) {
+    if (std::bit_cast<wide_word>(t) ==
+        std::bit_cast<wide_word>(expected)) {
+      t = desired;
+      return ATOMIC_OPS_CAS(true);
+    }
+    expected = t;
+    return ATOMIC_OPS_CAS(false);
+  }
+  else {
+    return ATOMIC_OPS_CAS(wide_compare_exchange(t, expected, T(desired)));
+  }
+}
 }
@@ -0,0 +1,319 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include "atomic_ops.hpp"
+#include "bitmap_ops.hpp"
+#include "sharded_counter.hpp"
+#include <bit>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+namespace atomic_ops {
+/// The calling thread's starting word for the allocators.
+///
+/// Threads start at scattered words, so that they do not all contend on the
+/// first free bit, and then move the hint to the word of their last
+/// allocation, so that each thread keeps allocating from a word that it has
+/// recently found free bits in.
+inline std::size_t& bitmap_alloc_hint() {
+  thread_local std::size_t hint = this_thread_shard() * 0x9e3779b97f4a7c15u;
+  return hint;
+}
+
+/// Find the index of the first zero bit in [i, e), saturating at e.
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T>
+T bitmap_first_zero(const Word* bits, T i, T e, mm_tag<MM> mm = {}) {
+  constexpr int W = bitmap_word_bits<Word>;
+  if (i >= e) {
+    return e;
+  }
+
+  auto w = i / W;
+  auto b = i % W;
+  auto v = (e - 1) / W + 1;
+  Word d = load(bits[w], mm) | Word(bitmap_mask<Word>(b) - 1);
+  while (d == Word(~Word(0))) {
+    if (++w >= v) {
+      return e;
+    }
+    d = load(bits[w], mm);
+  }
+  T n = w * W + std::countr_one(d);
+  return (n < e) ? n : e;
+}
+
+/// Atomically claim a zero bit of the `w`th word that is also set in `valid`.
+///
+/// `d` is the caller's view of the word. Free bits are claimed lowest first
+/// with fetch_or, and each lost race continues with the value that fetch_or
+/// returned rather than reloading. Returns the bit, with `d` updated to the
+/// word including it, or -1 if the word has no free bits in `valid`.
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T>
+int bitmap_claim_zero(Word* bits, T w, std::type_identity_t<Word> valid,
+                      Word& d, mm_tag<MM> mm = {}) {
+  while (Word(~d & valid)) {
+    int b = std::countr_one(Word(d | ~valid));
+    auto m = bitmap_mask<Word>(b);
+    d = fetch_or(bits[w], m, mm);
+    if (!(d & m)) {
+      d |= m;
+      return b;
+    }
+  }
+  return -1;
+}
+
+/// Atomically allocate a zero bit of an `n` bit bitmap and set it.
+///
+/// The search starts at the calling thread's bitmap_alloc_hint() and wraps
+/// around. Returns the bit, or `n` if every bit is set.
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T>
+T bitmap_alloc(Word* bits, T n, mm_tag<MM> mm = {}) {
+  constexpr int W = bitmap_word_bits<Word>;
+  T words = bitmap_words<Word>(n);
+  if (words == 0) {
+    return n;
+  }
+
+  auto& hint = bitmap_alloc_hint();
+  T w = T(hint % words);
+  for (T k = 0; k < words; ++k, w = (w + 1 < words) ? w + 1 : 0) {
+    Word valid = ~Word(0);
+    if (w == words - 1 && n % W) {
+      valid = bitmap_mask<Word>(T(0), T(n % W));
+    }
+    Word d = load(bits[w], mm);
+    if (int b = bitmap_claim_zero(bits, w, valid, d, mm); b >= 0) {
+      hint = w;
+      return w * W + b;
+    }
+  }
+  return n;
+}
+
+/// Atomically claim the bits [i, i + k), all of which must be zero.
+///
+/// Each word is claimed with bitmap_claim_word. If another thread holds any
+/// of the bits then the words that this call already claimed are released
+/// and it fails.
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T>
+bool bitmap_try_claim(Word* bits, T i, T k, mm_tag<MM> mm = {}) {
+  constexpr int W = bitmap_word_bits<Word>;
+  auto e = i + k;
+  auto w = i / W;
+  auto b = i % W;
+  auto v = (e - 1) / W;
+  auto c = (e - 1) % W + 1;
+  for (auto u = w; u <= v; ++u, b = 0) {
+    auto m = bitmap_mask<Word>(b, (u == v) ? c : T(W));
+    if (auto claimed = bitmap_claim_word(bits, u, m, mm); claimed != m) {
+      if (claimed) {
+        fetch_and(bits[u], Word(~claimed), mm);
+      }
+      bitmap_clear_range(bits, i, u * W, mm);
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Atomically allocate `k` contiguous zero bits of an `n` bit bitmap.
+///
+/// This searches for a run of `k` zeros from the calling thread's hint to the
+/// end and then from the start, and claims it with bitmap_try_claim,
+/// continuing the search if it loses a race. Returns the first bit of the run,
+/// or `n` if there is none.
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T>
+T bitmap_alloc(Word* bits, T n, T k, mm_tag<MM> mm = {}) {
+  constexpr int W = bitmap_word_bits<Word>;
+  if (k == 0 || k > n) {
+    return n;
+  }
+
+  auto& hint = bitmap_alloc_hint();
+  T start = T(hint % bitmap_words<Word>(n)) * W;
+  T ranges[2][2] = {{start, n}, {0, (start + k - 1 < n) ? start + k - 1 : n}};
+  for (auto& [i, e] : ranges) {
+    while (e - i >= k) {
+      T z = bitmap_first_zero(bits, i, e, mm);
+      if (e - z < k) {
+        break;
+      }
+      T o = bitmap_first(bits, z, z + k, mm);
+      if (o < z + k) {
+        i = o + 1;
+      }
+      else if (bitmap_try_claim(bits, z, k, mm)) {
+        hint = (z + k - 1) / W;
+        return z;
+      }
+      else {
+        i = z;
+      }
+    }
+  }
+  return n;
+}
+
+/// Free a bit allocated by bitmap_alloc.
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T>
+void bitmap_free(Word* bits, T i, mm_tag<MM> mm = {}) {
+  constexpr int W = bitmap_word_bits<Word>;
+  fetch_and(bits[i / W], Word(~bitmap_mask<Word>(i % W)), mm);
+}
+
+/// Free the `k` contiguous bits at `i` allocated by bitmap_alloc.
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T>
+void bitmap_free(Word* bits, T i, T k, mm_tag<MM> mm = {}) {
+  bitmap_clear_range(bits, i, i + k, mm);
+}
+
+/// A bit allocator with a summary of the full words.
+///
+/// Bit `w` of the summary is set while word `w` has no free bits, so alloc()
+/// finds a word with a free bit by scanning the summary for a zero, which
+/// skips 64 full words per load. The bits past size() in the last word are
+/// kept set so that they are never allocated. The summary is updated with
+/// acq_rel RMWs and a word that is marked full is rechecked afterwards, so a
+/// race between filling and freeing a word can leave a full word marked as
+/// having space, which costs one failed claim, but never the reverse.
+template <MemoryModel MM = ReleaseConsistency>
+class bitmap_allocator {
+  static constexpr mm_tag<MM> mm = {};
+
+  std::size_t n_;
+  std::vector<unsigned long> words_;
+  std::vector<unsigned long> full_;
+
+  void mark_full(std::size_t w) {
+    auto m = bitmap_mask(w % BITMAP_WORD_BITS);
+    fetch_or(full_[w / BITMAP_WORD_BITS], m, acq_rel);
+    if (load(words_[w], acquire) != ~0ul) {
+      fetch_and(full_[w / BITMAP_WORD_BITS], ~m, acq_rel);  // raced with a free
+    }
+  }
+
+  void mark_free(std::size_t w) {
+    fetch_and(full_[w / BITMAP_WORD_BITS], ~bitmap_mask(w % BITMAP_WORD_BITS),
+              acq_rel);
+  }
+
+  /// Clear the `m` bits of word `w`, updating the summary if it was full.
+  void release(std::size_t w, unsigned long m) {
+    if (fetch_and(words_[w], ~m, mm) == ~0ul) {
+      mark_free(w);
+    }
+  }
+
+ public:
+  /// Create an allocator of `n` bits, all free.
+  explicit bitmap_allocator(std::size_t n)
+      : n_(n), words_(bitmap_words(n)), full_(bitmap_words(words_.size())) {
+    if (auto b = n % BITMAP_WORD_BITS) {
+      words_.back() = ~bitmap_mask(std::size_t(0), b);
+    }
+    if (auto b = words_.size() % BITMAP_WORD_BITS) {
+      full_.back() = ~bitmap_mask(std::size_t(0), b);
+    }
+  }
+
+  bitmap_allocator(const bitmap_allocator&) = delete;
+  bitmap_allocator& operator=(const bitmap_allocator&) = delete;
+
+  std::size_t size() const {
+    return n_;
+  }
+
+  const unsigned long* data() const {
+    return words_.data();
+  }
+
+  /// Allocate a bit, returning it, or size() if every bit is allocated.
+  std::size_t alloc() {
+    std::size_t words = words_.size();
+    if (words == 0) {
+      return n_;
+    }
+
+    auto& hint = bitmap_alloc_hint();
+    std::size_t start = hint % words;
+    std::size_t ranges[2][2] = {{start, words}, {0, start}};
+    for (auto& [i, e] : ranges) {
+      for (auto w = bitmap_first_zero(full_.data(), i, e, rc); w < e;
+           w = bitmap_first_zero(full_.data(), w + 1, e, rc)) {
+        unsigned long d = load(words_[w], mm);
+        if (int b = bitmap_claim_zero(words_.data(), w, ~0ul, d, mm); b >= 0) {
+          if (d == ~0ul) {
+            mark_full(w);
+          }
+          hint = w;
+          return w * BITMAP_WORD_BITS + b;
+        }
+      }
+    }
+    return n_;
+  }
+
+  /// Allocate `k` contiguous bits, returning the first, or size() if there is
+  /// no free run that long.
+  std::size_t alloc(std::size_t k) {
+    std::size_t i = bitmap_alloc(words_.data(), n_, k, mm);
+    if (i < n_) {
+      for (auto w = i / BITMAP_WORD_BITS; w <= (i + k - 1) / BITMAP_WORD_BITS;
+           ++w) {
+        if (load(words_[w], mm) == ~0ul) {
+          mark_full(w);
+        }
+      }
+    }
+    return i;
+  }
+
+  /// Free a bit returned by alloc().
+  void free(std::size_t i) {
+    release(i / BITMAP_WORD_BITS, bitmap_mask(i % BITMAP_WORD_BITS));
+  }
+
+  /// Free the `k` bits returned by alloc(k).
+  void free(std::size_t i, std::size_t k) {
+    auto e = i + k;
+    auto w = i / BITMAP_WORD_BITS;
+    auto b = i % BITMAP_WORD_BITS;
+    auto v = (e - 1) / BITMAP_WORD_BITS;
+    auto c = (e - 1) % BITMAP_WORD_BITS + 1;
+    for (; w <= v; ++w, b = 0) {
+      release(w, bitmap_mask(b, (w == v) ? c : std::size_t(BITMAP_WORD_BITS)));
+    }
+  }
+};
+}
@@ -32,76 +32,541 @@
 
 #include "atomic_ops.hpp"
 #include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 
 namespace atomic_ops {
-static constexpr int BITMAP_WORD_BITS = 8 * sizeof(unsigned long);
+/// The word types that a bitmap can be stored in.
+///
+/// Words narrower than `unsigned` are excluded because they promote to `int`
+/// in the mask arithmetic.
+template <typename Word>
+concept bitmap_word = std::unsigned_integral<Word> &&
+                      sizeof(Word) >= sizeof(unsigned);
+
+template <typename Word>
+inline constexpr int bitmap_word_bits = 8 * sizeof(Word);
+
+static constexpr int BITMAP_WORD_BITS = bitmap_word_bits<unsigned long>;
+static constexpr int BITMAP_WORD_SHIFT =
+    std::countr_zero(unsigned(BITMAP_WORD_BITS));
+
+/// The number of words that bitmap_next tests at each step.
+#if defined(__AVX512F__)
+static constexpr int BITMAP_SCAN_WORDS = 64 / sizeof(unsigned long);
+#else
+static constexpr int BITMAP_SCAN_WORDS = 32 / sizeof(unsigned long);
+#endif
+
+/// BITMAP_SCAN_WORDS scaled to `Word`, so that a scan covers the same bytes.
+template <typename Word>
+inline constexpr int bitmap_scan_words =
+    BITMAP_SCAN_WORDS * sizeof(unsigned long) / sizeof(Word);
 
-template <typename T>
-unsigned long bitmap_mask(T t) {
-  return 1ul << t;
+template <typename Word = unsigned long, typename T>
+Word bitmap_mask(T t) {
+  return Word(1) << t;
 }
 
-template <typename T>
+/// Compute the mask for the bits [b, e) in a word, for b < e <= word bits.
+template <typename Word = unsigned long, typename T>
+Word bitmap_mask(T b, T e) {
+  return Word(~Word(0) >> (bitmap_word_bits<Word> - (e - b))) << b;
+}
+
+template <typename Word = unsigned long, typename T>
 T bitmap_words(T n) {
-  auto w = n / BITMAP_WORD_BITS;
-  auto b = n % BITMAP_WORD_BITS;
+  auto w = n / bitmap_word_bits<Word>;
+  auto b = n % bitmap_word_bits<Word>;
   return w + ((b) ? 1 : 0);
 }
 
 /// Atomically get a bit.
-template <MemoryModel MM = ReleaseConsistency, typename T>
-unsigned long bitmap_get(const unsigned long* bits, T i, mm_tag<MM> mm = {}) {
-  auto w = i / BITMAP_WORD_BITS;
-  auto b = i % BITMAP_WORD_BITS;
-  auto m = bitmap_mask(b);
-  return load(bits[w], mm) & m;
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T>
+Word bitmap_get(const Word* bits, T i, mm_tag<MM> mm = {} ATOMIC_OPS_SITE) {
+  constexpr int W = bitmap_word_bits<Word>;
+  auto w = i / W;
+  auto b = i % W;
+  auto m = bitmap_mask<Word>(b);
+  return load(bits[w], mm ATOMIC_OPS_SITE_ARG) & m;
 }
 
 /// Atomically set a bit.
 ///
 /// Returns the previous value of the bit.
-template <MemoryModel MM = ReleaseConsistency, typename T>
-unsigned long bitmap_set(unsigned long* bits, T i, mm_tag<MM> mm = {}) {
-  auto w = i / BITMAP_WORD_BITS;
-  auto b = i % BITMAP_WORD_BITS;
-  auto m = bitmap_mask(b);
-  return fetch_or(bits[w], m, mm) & m;
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T>
+Word bitmap_set(Word* bits, T i, mm_tag<MM> mm = {} ATOMIC_OPS_SITE) {
+  constexpr int W = bitmap_word_bits<Word>;
+  auto w = i / W;
+  auto b = i % W;
+  auto m = bitmap_mask<Word>(b);
+  return fetch_or(bits[w], m, mm ATOMIC_OPS_SITE_ARG) & m;
 }
 
 /// Atomically clear a bit in a bitmap.
 ///
 /// Returns the previous value of the bit.
-template <MemoryModel MM = ReleaseConsistency, typename T>
-unsigned long bitmap_clear(unsigned long* bits, T i, mm_tag<MM> mm = {}) {
-  auto w = i / BITMAP_WORD_BITS;
-  auto b = i % BITMAP_WORD_BITS;
-  auto m = ~bitmap_mask(b);
-  return fetch_and(bits[w], m, mm) & m;
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T>
+Word bitmap_clear(Word* bits, T i, mm_tag<MM> mm = {} ATOMIC_OPS_SITE) {
+  constexpr int W = bitmap_word_bits<Word>;
+  auto w = i / W;
+  auto b = i % W;
+  auto m = bitmap_mask<Word>(b);
+  return fetch_and(bits[w], Word(~m), mm ATOMIC_OPS_SITE_ARG) & m;
+}
+
+/// Check if any of the `bitmap_scan_words<Word>` words starting at `bits` is
+/// non-zero.
+///
+/// The Unsynchronized variant uses vector loads where they are available. The
+/// atomic variants load each word individually and combine them so that there
+/// is only one branch per block. Only SequentialConsistency needs its ordering
+/// here, the other models are read with relaxed loads because the caller
+/// reloads the word that it returns with the complete model.
+template <MemoryModel MM, bitmap_word Word>
+bool bitmap_any_block(const Word* bits, mm_tag<MM> = {} ATOMIC_OPS_SITE) {
+  constexpr int K = bitmap_scan_words<Word>;
+  if constexpr (MM == Unsynchronized) {
+#if defined(__AVX512F__)
+    __m512i v = _mm512_loadu_si512(bits);
+    return _mm512_test_epi64_mask(v, v) != 0;
+#elif defined(__AVX2__)
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bits));
+    return !_mm256_testz_si256(v, v);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    auto p = reinterpret_cast<const uint64_t*>(bits);
+    uint64x2_t v = vorrq_u64(vld1q_u64(p), vld1q_u64(p + 2));
+    return (vgetq_lane_u64(v, 0) | vgetq_lane_u64(v, 1)) != 0;
+#else
+    Word d = 0;
+    for (int k = 0; k < K; ++k) {
+      d |= bits[k];
+    }
+    return d != 0;
+#endif
+  }
+  else {
+    constexpr auto mm = (MM == SequentialConsistency) ? SequentialConsistency
+                                                      : RelaxedConsistency;
+    Word d = 0;
+    for (int k = 0; k < K; ++k) {
+      d |= load(bits[k], mm_tag<mm>{} ATOMIC_OPS_SITE_ARG);
+    }
+    return d != 0;
+  }
 }
 
 /// Find the index of the next non-zero in the bitmap.
-template <MemoryModel MM = ReleaseConsistency, typename T>
-T bitmap_next(const unsigned long* bits, T i, T e, mm_tag<MM> mm = {}) {
-  if (unlikely(++i >= e)) {
+///
+/// Whole blocks of zero words are skipped with bitmap_any_block, and the block
+/// that contains a non-zero word is then scanned a word at a time.
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T>
+T bitmap_next(const Word* bits, T i, T e,
+              mm_tag<MM> mm = {} ATOMIC_OPS_SITE) {
+  constexpr int W = bitmap_word_bits<Word>;
+  constexpr int K = bitmap_scan_words<Word>;
+  if (++i >= e) {
     return e;                                   // saturate at e
   }
 
-  auto w = i / BITMAP_WORD_BITS;
-  auto b = i % BITMAP_WORD_BITS;
-  auto d = load(bits[w], mm) >> b;
+  auto w = i / W;
+  auto b = i % W;
 
-  if (likely(d)) {
+  if (auto d = Word(load(bits[w], mm ATOMIC_OPS_SITE_ARG) >> b)) {
     auto n = i + std::countr_zero(d);
     return (n < e) ? n : e;                 // saturate at e (avoid <algorithm>)
   }
 
-  // -1 because next ++i
-  return bitmap_next(bits, i + (BITMAP_WORD_BITS - b) - 1, e, mm);
+  auto v = (e - 1) / W + 1;                 // one past the last word
+  ++w;
+  while (w < v) {
+    while (w + K <= v && !bitmap_any_block(bits + w, mm ATOMIC_OPS_SITE_ARG)) {
+      w += K;
+    }
+
+    auto u = (w + K < v) ? w + K : v;
+    for (; w < u; ++w) {
+      if (auto d = load(bits[w], mm ATOMIC_OPS_SITE_ARG)) {
+        T n = w * W + std::countr_zero(d);
+        return (n < e) ? n : e;
+      }
+    }
+  }
+
+  return e;
 }
 
 /// First the first non-zero in the bitmap
-template <MemoryModel MM = ReleaseConsistency, typename T>
-T bitmap_first(const unsigned long* bits, T i, T e, mm_tag<MM> mm = {}) {
-  return (bitmap_get(bits, i, mm)) ? i : bitmap_next(bits, i, e, mm);
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T>
+T bitmap_first(const Word* bits, T i, T e,
+               mm_tag<MM> mm = {} ATOMIC_OPS_SITE) {
+  return (bitmap_get(bits, i, mm ATOMIC_OPS_SITE_ARG))
+             ? i
+             : bitmap_next(bits, i, e, mm ATOMIC_OPS_SITE_ARG);
+}
+
+/// Set all of the bits in [i, e).
+///
+/// The partial words at either end of the range are updated with a single
+/// masked fetch_or, while the interior words are simply stored.
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T>
+void bitmap_set_range(Word* bits, T i, T e,
+                      mm_tag<MM> mm = {} ATOMIC_OPS_SITE) {
+  constexpr int W = bitmap_word_bits<Word>;
+  if (i >= e) {
+    return;
+  }
+
+  auto w = i / W;
+  auto b = i % W;
+  auto v = (e - 1) / W;
+  auto c = (e - 1) % W + 1;
+
+  if (w == v) {
+    fetch_or(bits[w], bitmap_mask<Word>(b, c), mm ATOMIC_OPS_SITE_ARG);
+    return;
+  }
+
+  fetch_or(bits[w], bitmap_mask<Word>(b, T(W)), mm ATOMIC_OPS_SITE_ARG);
+  for (++w; w < v; ++w) {
+    store(bits[w], Word(~Word(0)), mm ATOMIC_OPS_SITE_ARG);
+  }
+  fetch_or(bits[v], bitmap_mask<Word>(T(0), c), mm ATOMIC_OPS_SITE_ARG);
+}
+
+/// Clear all of the bits in [i, e).
+///
+/// The partial words at either end of the range are updated with a single
+/// masked fetch_and, while the interior words are simply stored.
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T>
+void bitmap_clear_range(Word* bits, T i, T e,
+                        mm_tag<MM> mm = {} ATOMIC_OPS_SITE) {
+  constexpr int W = bitmap_word_bits<Word>;
+  if (i >= e) {
+    return;
+  }
+
+  auto w = i / W;
+  auto b = i % W;
+  auto v = (e - 1) / W;
+  auto c = (e - 1) % W + 1;
+
+  if (w == v) {
+    fetch_and(bits[w], Word(~bitmap_mask<Word>(b, c)), mm ATOMIC_OPS_SITE_ARG);
+    return;
+  }
+
+  fetch_and(bits[w], Word(~bitmap_mask<Word>(b, T(W))),
+            mm ATOMIC_OPS_SITE_ARG);
+  for (++w; w < v; ++w) {
+    store(bits[w], Word(0), mm ATOMIC_OPS_SITE_ARG);
+  }
+  fetch_and(bits[v], Word(~bitmap_mask<Word>(T(0), c)),
+            mm ATOMIC_OPS_SITE_ARG);
+}
+
+/// Count the number of set bits in [i, e).
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T>
+T bitmap_count(const Word* bits, T i, T e,
+               mm_tag<MM> mm = {} ATOMIC_OPS_SITE) {
+  constexpr int W = bitmap_word_bits<Word>;
+  if (i >= e) {
+    return 0;
+  }
+
+  auto w = i / W;
+  auto b = i % W;
+  auto v = (e - 1) / W;
+  auto c = (e - 1) % W + 1;
+
+  if (w == v) {
+    auto d = load(bits[w], mm ATOMIC_OPS_SITE_ARG);
+    return std::popcount(Word(d & bitmap_mask<Word>(b, c)));
+  }
+
+  auto d = load(bits[w], mm ATOMIC_OPS_SITE_ARG);
+  T n = std::popcount(Word(d & bitmap_mask<Word>(b, T(W))));
+  for (++w; w < v; ++w) {
+    n += std::popcount(load(bits[w], mm ATOMIC_OPS_SITE_ARG));
+  }
+  d = load(bits[v], mm ATOMIC_OPS_SITE_ARG);
+  return n + std::popcount(Word(d & bitmap_mask<Word>(T(0), c)));
+}
+
+/// Atomically set the bits in `mask` in the `w`th word of the bitmap.
+///
+/// Returns the bits that this call set, i.e., the bits in `mask` that were not
+/// already set. Words that have no unset bits in `mask` are only loaded.
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T>
+Word bitmap_claim_word(Word* bits, T w, std::type_identity_t<Word> mask,
+                       mm_tag<MM> mm = {} ATOMIC_OPS_SITE) {
+  if ((mask & ~load(bits[w], mm ATOMIC_OPS_SITE_ARG)) == 0) {
+    return 0;
+  }
+  return mask & ~fetch_or(bits[w], mask, mm ATOMIC_OPS_SITE_ARG);
+}
+
+/// Atomically claim all of the bits in [i, e).
+///
+/// Calls `f(w, claimed)` for each word `w` in which this call set any bits,
+/// where `claimed` are the bits that were set.
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T,
+          typename F>
+void bitmap_claim_range(Word* bits, T i, T e, F&& f,
+                        mm_tag<MM> mm = {} ATOMIC_OPS_SITE) {
+  constexpr int W = bitmap_word_bits<Word>;
+  if (i >= e) {
+    return;
+  }
+
+  auto w = i / W;
+  auto b = i % W;
+  auto v = (e - 1) / W;
+  auto c = (e - 1) % W + 1;
+
+  for (; w <= v; ++w, b = 0) {
+    auto m = bitmap_mask<Word>(b, (w == v) ? c : T(W));
+    if (auto claimed = bitmap_claim_word(bits, w, m, mm ATOMIC_OPS_SITE_ARG)) {
+      f(w, claimed);
+    }
+  }
+}
+
+/// Atomically set each of the bits in [first, last).
+///
+/// Consecutive indices that fall in the same word are coalesced into a single
+/// bitmap_claim_word, so sorted or bucketed input costs one RMW per distinct
+/// word. Unsorted input is still correct, it just coalesces less. Calls
+/// `f(w, set)` for each word `w` in which this call set any bits, and returns
+/// the number of bits that it set.
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename It,
+          typename F>
+std::size_t bitmap_set_batch(Word* bits, It first, It last, F&& f,
+                             mm_tag<MM> mm = {} ATOMIC_OPS_SITE) {
+  constexpr int W = bitmap_word_bits<Word>;
+  std::size_t n = 0;
+  while (first != last) {
+    auto w = *first / W;
+    Word m = 0;
+    for (; first != last && *first / W == w; ++first) {
+      m |= bitmap_mask<Word>(*first % W);
+    }
+    if (auto set = bitmap_claim_word(bits, w, m, mm ATOMIC_OPS_SITE_ARG)) {
+      n += std::popcount(set);
+      f(w, set);
+    }
+  }
+  return n;
+}
+
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename It>
+std::size_t bitmap_set_batch(Word* bits, It first, It last,
+                             mm_tag<MM> mm = {} ATOMIC_OPS_SITE) {
+  return bitmap_set_batch(bits, first, last, [](auto, Word) {},
+                          mm ATOMIC_OPS_SITE_ARG);
+}
+
+/// Atomically clear each of the bits in [first, last).
+///
+/// Indices are coalesced like bitmap_set_batch. Calls `f(w, cleared)` for
+/// each word `w` in which this call cleared any bits, and returns the number
+/// of bits that it cleared.
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename It,
+          typename F>
+std::size_t bitmap_clear_batch(Word* bits, It first, It last, F&& f,
+                               mm_tag<MM> mm = {} ATOMIC_OPS_SITE) {
+  constexpr int W = bitmap_word_bits<Word>;
+  std::size_t n = 0;
+  while (first != last) {
+    auto w = *first / W;
+    Word m = 0;
+    for (; first != last && *first / W == w; ++first) {
+      m |= bitmap_mask<Word>(*first % W);
+    }
+    if (Word cleared = m & fetch_and(bits[w], Word(~m),
+                                     mm ATOMIC_OPS_SITE_ARG)) {
+      n += std::popcount(cleared);
+      f(w, cleared);
+    }
+  }
+  return n;
+}
+
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename It>
+std::size_t bitmap_clear_batch(Word* bits, It first, It last,
+                               mm_tag<MM> mm = {} ATOMIC_OPS_SITE) {
+  return bitmap_clear_batch(bits, first, last, [](auto, Word) {},
+                            mm ATOMIC_OPS_SITE_ARG);
+}
+
+/// The number of unsigned long words in the widest vector register of the
+/// target.
+#if defined(__AVX512F__)
+static constexpr int BITMAP_VECTOR_WORDS = 64 / sizeof(unsigned long);
+#elif defined(__AVX__)
+static constexpr int BITMAP_VECTOR_WORDS = 32 / sizeof(unsigned long);
+#else
+static constexpr int BITMAP_VECTOR_WORDS = 16 / sizeof(unsigned long);
+#endif
+
+/// A vector register of `Word`s as a compiler vector, which lowers to SSE,
+/// AVX2, AVX-512, or NEON operations depending on the target.
+///
+/// This is a member typedef rather than an alias template because GCC drops
+/// `vector_size` when it is applied to a dependent type in an alias.
+template <typename Word>
+struct bitmap_vector {
+  typedef Word type
+      __attribute__((vector_size(BITMAP_VECTOR_WORDS * sizeof(unsigned long))));
+};
+
+using bitmap_block = bitmap_vector<unsigned long>::type;
+
+/// Compute `dst = op(a, b)` over the words of an `n` bit bitmap.
+///
+/// Returns the number of bits set in the result. The Unsynchronized variant
+/// processes a bitmap_vector at a time, the other models load and store each
+/// word with `mm`, since vector accesses are not atomic.
+template <MemoryModel MM, bitmap_word Word, typename T, typename Op>
+T bitmap_combine(Word* dst, const Word* a, const Word* b, T n, Op&& op,
+                 mm_tag<MM> mm ATOMIC_OPS_SITE) {
+  T words = bitmap_words<Word>(n);
+  T count = 0;
+  T w = 0;
+  if constexpr (MM == Unsynchronized) {
+    using block = typename bitmap_vector<Word>::type;
+    constexpr int K = sizeof(block) / sizeof(Word);
+    for (; w + K <= words; w += K) {
+      block x, y;
+      std::memcpy(&x, a + w, sizeof(x));
+      std::memcpy(&y, b + w, sizeof(y));
+      block z = op(x, y);
+      std::memcpy(dst + w, &z, sizeof(z));
+      for (int k = 0; k < K; ++k) {
+        count += std::popcount(Word(z[k]));
+      }
+    }
+  }
+  for (; w < words; ++w) {
+    Word x = load(a[w], mm ATOMIC_OPS_SITE_ARG);
+    Word z = op(x, load(b[w], mm ATOMIC_OPS_SITE_ARG));
+    store(dst[w], z, mm ATOMIC_OPS_SITE_ARG);
+    count += std::popcount(z);
+  }
+  return count;
+}
+
+/// Compute `dst = op(dst, src)` over the words of an `n` bit bitmap.
+///
+/// The atomic variants update each word of `dst` with `rmw(dst[w], s, mm)`, so
+/// the destination can be shared, and only load words where `s` is `id`, the
+/// identity of `op`. Returns the number of bits set in the result.
+template <MemoryModel MM, bitmap_word Word, typename T, typename Op,
+          typename RMW>
+T bitmap_combine_into(Word* dst, const Word* src, T n, Op&& op, RMW&& rmw,
+                      std::type_identity_t<Word> id,
+                      mm_tag<MM> mm ATOMIC_OPS_SITE) {
+  if constexpr (MM == Unsynchronized) {
+    return bitmap_combine(dst, dst, src, n, op, mm ATOMIC_OPS_SITE_ARG);
+  }
+  else {
+    T count = 0;
+    for (T w = 0, e = bitmap_words<Word>(n); w < e; ++w) {
+      Word s = load(src[w], mm ATOMIC_OPS_SITE_ARG);
+      Word d = (s == id) ? load(dst[w], mm ATOMIC_OPS_SITE_ARG)
+                         : rmw(dst[w], s, mm ATOMIC_OPS_SITE_ARG);
+      count += std::popcount(Word(op(d, s)));
+    }
+    return count;
+  }
+}
+
+/// Compute `dst = a & b`, returning the number of bits set in `dst`.
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T>
+T bitmap_and(Word* dst, const Word* a, const Word* b, T n,
+             mm_tag<MM> mm = {} ATOMIC_OPS_SITE) {
+  return bitmap_combine(dst, a, b, n, [](auto x, auto y) {
+    return x & y;
+  }, mm ATOMIC_OPS_SITE_ARG);
+}
+
+/// Compute `dst = a | b`, returning the number of bits set in `dst`.
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T>
+T bitmap_or(Word* dst, const Word* a, const Word* b, T n,
+            mm_tag<MM> mm = {} ATOMIC_OPS_SITE) {
+  return bitmap_combine(dst, a, b, n, [](auto x, auto y) {
+    return x | y;
+  }, mm ATOMIC_OPS_SITE_ARG);
+}
+
+/// Compute `dst = a ^ b`, returning the number of bits set in `dst`.
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T>
+T bitmap_xor(Word* dst, const Word* a, const Word* b, T n,
+             mm_tag<MM> mm = {} ATOMIC_OPS_SITE) {
+  return bitmap_combine(dst, a, b, n, [](auto x, auto y) {
+    return x ^ y;
+  }, mm ATOMIC_OPS_SITE_ARG);
+}
+
+/// Compute `dst = a & ~b`, returning the number of bits set in `dst`.
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T>
+T bitmap_andnot(Word* dst, const Word* a, const Word* b, T n,
+                mm_tag<MM> mm = {} ATOMIC_OPS_SITE) {
+  return bitmap_combine(dst, a, b, n, [](auto x, auto y) {
+    return x & ~y;
+  }, mm ATOMIC_OPS_SITE_ARG);
+}
+
+/// Compute `dst &= src` with fetch_and, returning the bits set in `dst`.
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T>
+T bitmap_and_into(Word* dst, const Word* src, T n,
+                  mm_tag<MM> mm = {} ATOMIC_OPS_SITE) {
+  return bitmap_combine_into(dst, src, n, [](auto x, auto y) {
+    return x & y;
+  }, [](auto& d, auto s, auto mm, auto... site) {
+    return fetch_and(d, s, mm, site...);
+  }, ~Word(0), mm ATOMIC_OPS_SITE_ARG);
+}
+
+/// Compute `dst |= src` with fetch_or, returning the bits set in `dst`.
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T>
+T bitmap_or_into(Word* dst, const Word* src, T n,
+                 mm_tag<MM> mm = {} ATOMIC_OPS_SITE) {
+  return bitmap_combine_into(dst, src, n, [](auto x, auto y) {
+    return x | y;
+  }, [](auto& d, auto s, auto mm, auto... site) {
+    return fetch_or(d, s, mm, site...);
+  }, 0, mm ATOMIC_OPS_SITE_ARG);
+}
+
+/// Compute `dst ^= src` with fetch_xor, returning the bits set in `dst`.
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T>
+T bitmap_xor_into(Word* dst, const Word* src, T n,
+                  mm_tag<MM> mm = {} ATOMIC_OPS_SITE) {
+  return bitmap_combine_into(dst, src, n, [](auto x, auto y) {
+    return x ^ y;
+  }, [](auto& d, auto s, auto mm, auto... site) {
+    return fetch_xor(d, s, mm, site...);
+  }, 0, mm ATOMIC_OPS_SITE_ARG);
+}
+
+/// Compute `dst &= ~src` with fetch_and, returning the bits set in `dst`.
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T>
+T bitmap_andnot_into(Word* dst, const Word* src, T n,
+                     mm_tag<MM> mm = {} ATOMIC_OPS_SITE) {
+  return bitmap_combine_into(dst, src, n, [](auto x, auto y) {
+    return x & ~y;
+  }, [](auto& d, auto s, auto mm, auto... site) {
+    return fetch_and(d, Word(~s), mm, site...);
+  }, 0, mm ATOMIC_OPS_SITE_ARG);
 }
 }
@@ -0,0 +1,319 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include "atomic_ops.hpp"
+#include "bitmap_ops.hpp"
+#include "bitmap_view.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(ATOMIC_OPS_EXECUTION)
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#endif
+
+namespace atomic_ops {
+/// The number of words in each chunk of a parallel bitmap operation.
+///
+/// This is a whole number of cachelines so that no two chunks share a line.
+static constexpr int BITMAP_CHUNK_WORDS =
+    64 * CACHELINE_BYTES / sizeof(unsigned long);
+
+/// Executors run `f(i)` for each chunk `i` in [0, n) and return when all of
+/// the chunks are complete.
+struct serial_executor {
+  template <typename F>
+  void operator()(std::size_t n, F&& f) const {
+    for (std::size_t i = 0; i < n; ++i) {
+      f(i);
+    }
+  }
+};
+
+#if defined(_OPENMP)
+struct omp_executor {
+  template <typename F>
+  void operator()(std::size_t n, F&& f) const {
+    #pragma omp parallel for schedule(dynamic)
+    for (std::size_t i = 0; i < n; ++i) {
+      f(i);
+    }
+  }
+};
+#endif
+
+#if defined(ATOMIC_OPS_EXECUTION)
+/// Run the chunks through a standard execution policy.
+///
+/// This is only defined with ATOMIC_OPS_EXECUTION, since libstdc++ implements
+/// the policies with TBB and <execution> needs -ltbb even if no policy is used.
+template <typename Policy>
+struct policy_executor {
+  Policy policy;
+
+  template <typename F>
+  void operator()(std::size_t n, F&& f) const {
+    std::vector<std::size_t> chunks(n);
+    std::iota(chunks.begin(), chunks.end(), std::size_t(0));
+    std::for_each(policy, chunks.begin(), chunks.end(), [&](std::size_t i) {
+      f(i);
+    });
+  }
+};
+
+template <typename Policy>
+policy_executor(Policy) -> policy_executor<Policy>;
+#endif
+
+/// The workers of a persistent pool, and the hand-off of each call to them.
+///
+/// A `Schedule` decides which thread runs which chunk. Each worker calls
+/// `enter(home)` once on its own thread, with the `home` that it was spawned
+/// with. Then every thread that takes part in a call, including the caller
+/// from `home()`, runs `drain(home, run)`, which calls `run(i)` for each chunk
+/// `i` that it claims until there are none left. The schedule is only reset
+/// under the pool's lock while no thread is draining it.
+///
+/// A task that calls back into the pool that is running it, for instance a
+/// nested bitmap_for_each_parallel, runs the nested call inline on its own
+/// thread rather than waiting for workers that are all busy.
+template <typename Schedule>
+class worker_pool {
+  std::mutex run_;                              // serializes dispatch()
+  std::mutex m_;
+  std::condition_variable work_;
+  std::condition_variable done_;
+  std::vector<std::thread> workers_;
+  std::size_t generation_ = 0;
+  unsigned active_ = 0;
+  bool stop_ = false;
+
+  void (*fn_)(void*, std::size_t) = nullptr;
+  void* ctx_ = nullptr;
+
+  /// The pool whose tasks the calling thread is running, if any.
+  static worker_pool*& running() {
+    thread_local worker_pool* pool = nullptr;
+    return pool;
+  }
+
+  void drain(std::size_t home) {
+    schedule_.drain(home, [this](std::size_t i) { fn_(ctx_, i); });
+  }
+
+  void work(std::size_t home) {
+    schedule_.enter(home);
+    running() = this;
+    std::size_t seen = 0;
+    while (true) {
+      {
+        std::unique_lock lock(m_);
+        work_.wait(lock, [&] { return stop_ || generation_ != seen; });
+        if (stop_) {
+          return;
+        }
+        seen = generation_;
+      }
+      drain(home);
+      {
+        std::lock_guard lock(m_);
+        if (--active_ == 0) {
+          done_.notify_one();
+        }
+      }
+    }
+  }
+
+ protected:
+  Schedule schedule_;
+
+  template <typename... Args>
+  explicit worker_pool(Args&&... args)
+      : schedule_(std::forward<Args>(args)...) {
+  }
+
+  ~worker_pool() {
+    {
+      std::lock_guard lock(m_);
+      stop_ = true;
+    }
+    work_.notify_all();
+    for (auto& worker : workers_) {
+      worker.join();
+    }
+  }
+
+  /// Start a worker that drains from `home`.
+  void spawn(std::size_t home) {
+    workers_.emplace_back([this, home] { work(home); });
+  }
+
+  /// Run `f(i)` for each of the `n` chunks, after `reset(schedule_)` has laid
+  /// them out, and return when they are all complete.
+  template <typename Reset, typename F>
+  void dispatch(std::size_t n, Reset&& reset, F&& f) {
+    if (running() == this) {
+      for (std::size_t i = 0; i < n; ++i) {
+        f(i);
+      }
+      return;
+    }
+    std::lock_guard run(run_);
+    {
+      std::lock_guard lock(m_);
+      reset(schedule_);
+      fn_ = [](void* ctx, std::size_t i) {
+        (*static_cast<std::remove_reference_t<F>*>(ctx))(i);
+      };
+      ctx_ = const_cast<void*>(static_cast<const void*>(std::addressof(f)));
+      active_ = workers_.size();
+      ++generation_;
+    }
+    work_.notify_all();
+    worker_pool* outer = std::exchange(running(), this);
+    drain(schedule_.home());
+    running() = outer;
+    std::unique_lock lock(m_);
+    done_.wait(lock, [&] { return active_ == 0; });
+  }
+
+ public:
+  worker_pool(const worker_pool&) = delete;
+  worker_pool& operator=(const worker_pool&) = delete;
+};
+
+/// The schedule of a thread_pool, a single counter that every thread claims
+/// chunks from with fetch_add, so threads that finish early keep taking work
+/// from the rest.
+class counter_schedule {
+  std::size_t n_ = 0;
+  std::size_t next_ = 0;
+
+ public:
+  void reset(std::size_t n) {
+    n_ = n;
+    next_ = 0;
+  }
+
+  void enter(std::size_t) {
+  }
+
+  std::size_t home() const {
+    return 0;
+  }
+
+  template <typename Run>
+  void drain(std::size_t, Run&& run) {
+    for (std::size_t i; (i = fetch_add(next_, 1, xc)) < n_;) {
+      run(i);
+    }
+  }
+};
+
+/// A simple persistent thread pool.
+///
+/// The calling thread and the workers claim chunks from a counter_schedule.
+class thread_pool : worker_pool<counter_schedule> {
+ public:
+  /// Create a pool that runs on `n` threads, including the calling thread.
+  explicit thread_pool(unsigned n = std::thread::hardware_concurrency()) {
+    for (unsigned i = 1; i < n; ++i) {
+      spawn(0);
+    }
+  }
+
+  template <typename F>
+  void operator()(std::size_t n, F&& f) {
+    dispatch(n, [n](counter_schedule& s) { s.reset(n); }, f);
+  }
+
+  /// The pool used when no executor is passed to a parallel bitmap operation.
+  static thread_pool& global() {
+    static thread_pool pool;
+    return pool;
+  }
+};
+
+/// Call `f(i)` for each set bit `i` in [0, n), in parallel.
+///
+/// The bitmap is split into chunks of BITMAP_CHUNK_WORDS unsigned longs,
+/// whatever its word type, that are passed to the executor. Calls to `f` from
+/// different chunks may be concurrent.
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T,
+          typename F, typename Executor>
+void bitmap_for_each_parallel(const Word* bits, T n, F&& f, mm_tag<MM> mm,
+                              Executor&& ex) {
+  constexpr T chunk_bits = T(BITMAP_CHUNK_WORDS) * BITMAP_WORD_BITS;
+  std::size_t chunks = (n + chunk_bits - 1) / chunk_bits;
+  ex(chunks, [&](std::size_t c) {
+    T i = T(c) * chunk_bits;
+    T e = (n - i < chunk_bits) ? n : i + chunk_bits;
+    for (T j : bitmap_view(bits, i, e, mm)) {
+      f(j);
+    }
+  });
+}
+
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T,
+          typename F>
+void bitmap_for_each_parallel(const Word* bits, T n, F&& f,
+                              mm_tag<MM> mm = {}) {
+  bitmap_for_each_parallel(bits, n, std::forward<F>(f), mm,
+                           thread_pool::global());
+}
+
+/// Count the set bits in [0, n), in parallel.
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T,
+          typename Executor>
+T bitmap_count_parallel(const Word* bits, T n, mm_tag<MM> mm, Executor&& ex) {
+  constexpr T chunk_bits = T(BITMAP_CHUNK_WORDS) * BITMAP_WORD_BITS;
+  std::size_t chunks = (n + chunk_bits - 1) / chunk_bits;
+  T count = 0;
+  ex(chunks, [&](std::size_t c) {
+    T i = T(c) * chunk_bits;
+    T e = (n - i < chunk_bits) ? n : i + chunk_bits;
+    fetch_add(count, bitmap_count(bits, i, e, mm), xc);
+  });
+  return count;
+}
+
+template <MemoryModel MM = ReleaseConsistency, bitmap_word Word, typename T>
+T bitmap_count_parallel(const Word* bits, T n, mm_tag<MM> mm = {}) {
+  return bitmap_count_parallel(bits, n, mm, thread_pool::global());
+}
+}
@@ -0,0 +1,145 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include "atomic_ops.hpp"
+#include "bitmap_ops.hpp"
+#include <bit>
+#include <cstddef>
+#include <iterator>
+#include <ranges>
+
+namespace atomic_ops {
+/// How far ahead of the current word the bitmap_view iterator prefetches.
+static constexpr int BITMAP_PREFETCH_WORDS =
+    4 * CACHELINE_BYTES / sizeof(unsigned long);
+
+/// A range over the indices of the set bits in [begin, end) of a bitmap.
+///
+/// The iterator caches the current word and clears its lowest set bit as it
+/// advances, so each word is loaded once with the requested memory model. A
+/// new cacheline is prefetched each time the iterator crosses into the next
+/// one.
+template <MemoryModel MM = ReleaseConsistency, typename T = std::size_t,
+          bitmap_word Word = unsigned long>
+class bitmap_view
+    : public std::ranges::view_interface<bitmap_view<MM, T, Word>> {
+  const Word* bits_ = nullptr;
+  T begin_ = 0;
+  T end_ = 0;
+
+ public:
+  class iterator {
+    static constexpr int W = bitmap_word_bits<Word>;
+    static constexpr int LINE_WORDS = CACHELINE_BYTES / sizeof(Word);
+    static constexpr int PREFETCH_WORDS =
+        BITMAP_PREFETCH_WORDS * sizeof(unsigned long) / sizeof(Word);
+
+    const Word* bits_ = nullptr;
+    T w_ = 0;                                   // current word
+    T v_ = 0;                                   // one past the last word
+    Word last_ = 0;                             // mask for the last word
+    Word d_ = 0;                                // remaining bits in w_
+
+    Word load_word(T w) const {
+      if (w % LINE_WORDS == 0) {
+        __builtin_prefetch(bits_ + w + PREFETCH_WORDS, 0);
+      }
+      auto d = load(bits_[w], mm_tag<MM>{});
+      return (w + 1 == v_) ? d & last_ : d;
+    }
+
+    void skip() {
+      while (d_ == 0 && ++w_ < v_) {
+        d_ = load_word(w_);
+      }
+    }
+
+   public:
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using iterator_concept = std::forward_iterator_tag;
+
+    iterator() = default;
+
+    iterator(const Word* bits, T i, T e) : bits_(bits) {
+      if (i >= e) {
+        return;
+      }
+      w_ = i / W;
+      v_ = (e - 1) / W + 1;
+      last_ = bitmap_mask<Word>(T(0), T((e - 1) % W + 1));
+      __builtin_prefetch(bits_ + w_ + PREFETCH_WORDS, 0);
+      d_ = load_word(w_) & Word(~(bitmap_mask<Word>(T(i % W)) - 1));
+      skip();
+    }
+
+    T operator*() const {
+      return w_ * W + std::countr_zero(d_);
+    }
+
+    iterator& operator++() {
+      d_ &= d_ - 1;
+      skip();
+      return *this;
+    }
+
+    iterator operator++(int) {
+      iterator temp = *this;
+      ++*this;
+      return temp;
+    }
+
+    friend bool operator==(const iterator& a, const iterator& b) {
+      return a.d_ == b.d_ && (a.d_ == 0 || a.w_ == b.w_);
+    }
+
+    friend bool operator==(const iterator& a, std::default_sentinel_t) {
+      return a.d_ == 0;
+    }
+  };
+
+  bitmap_view() = default;
+
+  bitmap_view(const Word* bits, T begin, T end, mm_tag<MM> = {})
+      : bits_(bits), begin_(begin), end_(end)
+  {
+  }
+
+  iterator begin() const {
+    return iterator(bits_, begin_, end_);
+  }
+
+  std::default_sentinel_t end() const {
+    return std::default_sentinel;
+  }
+};
+}
@@ -0,0 +1,122 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include "atomic_ops.hpp"
+#include "bitmap_ops.hpp"
+#include <cstddef>
+
+namespace atomic_ops {
+/// A small direct-mapped write-combining cache for bitmap updates.
+///
+/// Each thread uses its own combiner for a shared bitmap. set() and clear()
+/// only record the bit in the slot for its word, and a slot is written to the
+/// bitmap with one fetch_or and/or fetch_and, using `MM`, when it is evicted
+/// by another word or when flush() is called. Updates are therefore not
+/// visible to other threads until they are flushed, which suits phases that
+/// end in a barrier. flush() is a release, even when `MM` is
+/// RelaxedConsistency, so a flush followed by the barrier publishes every
+/// buffered update. The destructor flushes.
+template <MemoryModel MM = RelaxedConsistency, std::size_t Ways = 64>
+class bitmap_write_combiner {
+  static constexpr std::size_t EMPTY = ~std::size_t(0);
+  static constexpr mm_tag<MM> mm = {};
+
+  struct slot {
+    std::size_t w = EMPTY;
+    unsigned long set = 0;
+    unsigned long clear = 0;
+  };
+
+  unsigned long* bits_;
+  slot slots_[Ways] = {};
+
+  void write(slot& s) {
+    if (s.set) {
+      fetch_or(bits_[s.w], s.set, mm);
+    }
+    if (s.clear) {
+      fetch_and(bits_[s.w], ~s.clear, mm);
+    }
+    s = {};
+  }
+
+  slot& find(std::size_t w) {
+    slot& s = slots_[w % Ways];
+    if (s.w != w) {
+      if (s.w != EMPTY) {
+        write(s);
+      }
+      s.w = w;
+    }
+    return s;
+  }
+
+ public:
+  explicit bitmap_write_combiner(unsigned long* bits) : bits_(bits) {
+  }
+
+  ~bitmap_write_combiner() {
+    flush();
+  }
+
+  bitmap_write_combiner(const bitmap_write_combiner&) = delete;
+  bitmap_write_combiner& operator=(const bitmap_write_combiner&) = delete;
+
+  /// Buffer setting a bit.
+  void set(std::size_t i) {
+    auto m = bitmap_mask(i % BITMAP_WORD_BITS);
+    slot& s = find(i / BITMAP_WORD_BITS);
+    s.set |= m;
+    s.clear &= ~m;
+  }
+
+  /// Buffer clearing a bit.
+  void clear(std::size_t i) {
+    auto m = bitmap_mask(i % BITMAP_WORD_BITS);
+    slot& s = find(i / BITMAP_WORD_BITS);
+    s.clear |= m;
+    s.set &= ~m;
+  }
+
+  /// Write all of the buffered updates to the bitmap.
+  void flush() {
+    if constexpr (MM == RelaxedConsistency) {
+      thread_fence(rc);
+    }
+    for (auto& s : slots_) {
+      if (s.w != EMPTY) {
+        write(s);
+      }
+    }
+  }
+};
+}
@@ -0,0 +1,208 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include "atomic_ops.hpp"
+#include "bitmap_ops.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <stdexcept>
+
+namespace atomic_ops {
+/// A bitmap that owns its storage and grows without copying.
+///
+/// The words are stored in up to SEGMENTS segments, where
+/// segment `k` holds `base << k` words, so a word never moves once it has been
+/// allocated. Segments are allocated on demand by set() and reserve() and are
+/// published with a CAS. A thread that loses the race frees its own segment,
+/// which nobody else can have seen, so there is never a retired segment to
+/// reclaim while the bitmap is live.
+///
+/// The bit operations within a segment are the usual bitmap_* functions with
+/// the memory model `MM`. The segment pointers themselves are always published
+/// with release and read with acquire, unless `MM` is Unsynchronized.
+template <MemoryModel MM = ReleaseConsistency>
+class concurrent_bitmap {
+  static constexpr int SEGMENTS = 40;
+  static_assert(0 < SEGMENTS &&
+                    SEGMENTS < std::numeric_limits<std::size_t>::digits,
+                "segment sizes are computed as base << k");
+  static constexpr MemoryModel SEGMENT_MM =
+      (MM == Unsynchronized) ? Unsynchronized : ReleaseConsistency;
+  static constexpr mm_tag<MM> mm = {};
+  static constexpr mm_tag<SEGMENT_MM> segment_mm = {};
+
+  std::size_t base_;                            // words in segment 0
+  int base_log_;
+  unsigned long* segments_[SEGMENTS] = {};
+
+  struct location {
+    int k;
+    std::size_t offset;
+  };
+
+  location locate(std::size_t w) const {
+    std::size_t idx = w + base_;
+    int k = std::bit_width(idx) - 1 - base_log_;
+    return { k, idx - (base_ << k) };
+  }
+
+  std::size_t segment_words(int k) const {
+    return base_ << k;
+  }
+
+  /// The index of the first bit in segment `k`.
+  std::size_t segment_begin(int k) const {
+    return (segment_words(k) - base_) * BITMAP_WORD_BITS;
+  }
+
+  unsigned long* segment(int k) const {
+    return (k < SEGMENTS) ? load(segments_[k], segment_mm) : nullptr;
+  }
+
+  unsigned long* allocate(int k) {
+    if (k >= SEGMENTS) {
+      throw std::length_error("concurrent_bitmap index out of range");
+    }
+    if (auto* p = segment(k)) {
+      return p;
+    }
+
+    std::size_t n = segment_words(k);
+    auto* p = static_cast<unsigned long*>(::operator new(
+        n * sizeof(unsigned long), std::align_val_t(CACHELINE_BYTES)));
+    std::fill_n(p, n, 0ul);
+
+    unsigned long* expected = nullptr;
+    if (compare_exchange_strong(segments_[k], expected, p, segment_mm)) {
+      return p;
+    }
+    ::operator delete(p, std::align_val_t(CACHELINE_BYTES));
+    return expected;
+  }
+
+  /// Find the first set bit in [i, e), for i < e.
+  std::size_t scan(std::size_t i, std::size_t e) const {
+    for (int k = locate(i / BITMAP_WORD_BITS).k; k < SEGMENTS; ++k) {
+      std::size_t b = segment_begin(k);
+      if (b >= e) {
+        break;
+      }
+
+      if (auto* p = segment(k)) {
+        std::size_t lo = (i < b) ? 0 : i - b;
+        std::size_t hi = std::min(e - b, segment_words(k) * BITMAP_WORD_BITS);
+        std::size_t n = bitmap_first(p, lo, hi, mm);
+        if (n < hi) {
+          return b + n;
+        }
+      }
+    }
+    return e;
+  }
+
+ public:
+  /// Create a bitmap with storage for at least `n` bits.
+  ///
+  /// The first segment holds `base_words` words, rounded up to a power of two,
+  /// and each subsequent segment doubles the capacity.
+  explicit concurrent_bitmap(std::size_t n = 0, std::size_t base_words = 64)
+      : base_(std::bit_ceil(base_words)),
+        base_log_(std::countr_zero(base_))
+  {
+    reserve(n);
+  }
+
+  ~concurrent_bitmap() {
+    for (auto* p : segments_) {
+      if (p) {
+        ::operator delete(p, std::align_val_t(CACHELINE_BYTES));
+      }
+    }
+  }
+
+  concurrent_bitmap(const concurrent_bitmap&) = delete;
+  concurrent_bitmap& operator=(const concurrent_bitmap&) = delete;
+
+  /// Make sure that the bits [0, n) have storage.
+  void reserve(std::size_t n) {
+    if (n == 0) {
+      return;
+    }
+    for (int k = 0, e = locate((n - 1) / BITMAP_WORD_BITS).k; k <= e; ++k) {
+      allocate(k);
+    }
+  }
+
+  /// The number of bits that currently have storage.
+  std::size_t capacity() const {
+    int k = 0;
+    while (k < SEGMENTS && segment(k)) {
+      ++k;
+    }
+    return segment_begin(k);
+  }
+
+  unsigned long get(std::size_t i) const {
+    auto [k, w] = locate(i / BITMAP_WORD_BITS);
+    auto* p = segment(k);
+    return (p) ? bitmap_get(p + w, i % BITMAP_WORD_BITS, mm) : 0;
+  }
+
+  unsigned long set(std::size_t i) {
+    auto [k, w] = locate(i / BITMAP_WORD_BITS);
+    auto* p = segment(k);
+    if (!p) {
+      p = allocate(k);
+    }
+    return bitmap_set(p + w, i % BITMAP_WORD_BITS, mm);
+  }
+
+  unsigned long clear(std::size_t i) {
+    auto [k, w] = locate(i / BITMAP_WORD_BITS);
+    auto* p = segment(k);
+    return (p) ? bitmap_clear(p + w, i % BITMAP_WORD_BITS, mm) : 0;
+  }
+
+  /// Find the index of the next non-zero after `i`, saturating at `e`.
+  std::size_t next(std::size_t i, std::size_t e) const {
+    return (++i < e) ? scan(i, e) : e;
+  }
+
+  /// Find the index of the first non-zero at or after `i`, saturating at `e`.
+  std::size_t first(std::size_t i, std::size_t e) const {
+    return (i < e) ? scan(i, e) : e;
+  }
+};
+}
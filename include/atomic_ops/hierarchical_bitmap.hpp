@@ -0,0 +1,207 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include "atomic_ops.hpp"
+#include "bitmap_ops.hpp"
+#include <bit>
+#include <cstddef>
+#include <vector>
+
+namespace atomic_ops {
+/// A bitmap with summary levels for fast next/first on sparse sets.
+///
+/// Each bit in level `L + 1` records whether the corresponding word of level
+/// `L` is non-empty, so next() and first() skip an empty word of level `L`
+/// with a single bit of level `L + 1` and run in O(log n) word loads.
+///
+/// The summaries are conservative: a summary bit may be set for an empty word,
+/// which only costs a wasted descent, but is never clear for a non-empty word.
+/// With SequentialConsistency and ReleaseConsistency the summary is kept
+/// exact, where clear() repairs a summary bit if it races with a set(). With
+/// RelaxedConsistency set() still maintains the summary, but clear() never
+/// clears summary bits, which can be recomputed by rebuild() at a quiescent
+/// point like a barrier.
+template <MemoryModel MM = ReleaseConsistency>
+class hierarchical_bitmap {
+  static constexpr int MAX_LEVELS = 12;
+  static constexpr mm_tag<MM> mm = {};
+
+  std::vector<unsigned long> words_;
+  unsigned long* levels_[MAX_LEVELS] = {};
+  std::size_t size_[MAX_LEVELS] = {};           // bits at each level
+  int depth_ = 0;
+
+  /// Set the bit for word `x` of level `L - 1` and its ancestors.
+  ///
+  /// This cannot stop at a summary bit that is already set, since the thread
+  /// that set it may not have set its ancestors yet, and a scan that follows
+  /// this set() would then miss the bit. Bits that are already set cost a
+  /// load rather than an RMW, and there are only a few levels.
+  void mark(int L, std::size_t x) {
+    for (; L < depth_; ++L, x /= BITMAP_WORD_BITS) {
+      auto& word = levels_[L][x / BITMAP_WORD_BITS];
+      auto m = bitmap_mask(x % BITMAP_WORD_BITS);
+      if (!(load(word, mm) & m)) {
+        fetch_or(word, m, mm);
+      }
+    }
+  }
+
+  /// Clear the bit for word `x` of level `L - 1`, which has become empty.
+  void unmark(int L, std::size_t x) {
+    for (; L < depth_; ++L, x /= BITMAP_WORD_BITS) {
+      auto m = bitmap_mask(x % BITMAP_WORD_BITS);
+      auto old = fetch_and(levels_[L][x / BITMAP_WORD_BITS], ~m, mm);
+      if (load(levels_[L - 1][x], mm)) {
+        mark(L, x);                             // raced with a set
+        return;
+      }
+      if (old & ~m) {
+        return;
+      }
+    }
+  }
+
+ public:
+  /// Create an empty bitmap of `n` bits.
+  explicit hierarchical_bitmap(std::size_t n) {
+    std::size_t total = 0;
+    for (std::size_t bits = n; depth_ < MAX_LEVELS; ++depth_) {
+      size_[depth_] = bits;
+      total += bitmap_words(bits);
+      if (bitmap_words(bits) <= 1) {
+        ++depth_;
+        break;
+      }
+      bits = bitmap_words(bits);
+    }
+
+    words_.resize(total);
+    std::size_t offset = 0;
+    for (int L = 0; L < depth_; ++L) {
+      levels_[L] = words_.data() + offset;
+      offset += bitmap_words(size_[L]);
+    }
+  }
+
+  hierarchical_bitmap(const hierarchical_bitmap&) = delete;
+  hierarchical_bitmap& operator=(const hierarchical_bitmap&) = delete;
+
+  std::size_t size() const {
+    return size_[0];
+  }
+
+  /// The base level, which can be passed to the bitmap_* read operations.
+  const unsigned long* data() const {
+    return levels_[0];
+  }
+
+  unsigned long get(std::size_t i) const {
+    return bitmap_get(levels_[0], i, mm);
+  }
+
+  /// Set a bit, returning its previous value.
+  unsigned long set(std::size_t i) {
+    auto w = i / BITMAP_WORD_BITS;
+    auto m = bitmap_mask(i % BITMAP_WORD_BITS);
+    auto old = fetch_or(levels_[0][w], m, mm);
+    mark(1, w);
+    return old & m;
+  }
+
+  /// Clear a bit, returning its previous value.
+  unsigned long clear(std::size_t i) {
+    auto w = i / BITMAP_WORD_BITS;
+    auto m = bitmap_mask(i % BITMAP_WORD_BITS);
+    auto old = fetch_and(levels_[0][w], ~m, mm);
+    if constexpr (MM != RelaxedConsistency) {
+      if (old == m) {
+        unmark(1, w);
+      }
+    }
+    return old & m;
+  }
+
+  /// Recompute the summary levels from the base level.
+  ///
+  /// This must not run concurrently with set() or clear().
+  void rebuild() {
+    for (int L = 1; L < depth_; ++L) {
+      for (std::size_t w = 0, e = bitmap_words(size_[L]); w < e; ++w) {
+        unsigned long d = 0;
+        for (std::size_t b = 0; b < BITMAP_WORD_BITS; ++b) {
+          std::size_t x = w * BITMAP_WORD_BITS + b;
+          if (x < size_[L] && load(levels_[L - 1][x], mm)) {
+            d |= bitmap_mask(b);
+          }
+        }
+        store(levels_[L][w], d, mm);
+      }
+    }
+  }
+
+  /// Find the index of the first non-zero at or after `i`, saturating at `e`.
+  ///
+  /// Like bitmap_first, this returns `e` when there is none, even if `e` is
+  /// larger than the bitmap.
+  std::size_t first(std::size_t i, std::size_t e) const {
+    std::size_t end = (e < size_[0]) ? e : size_[0];
+
+    int L = 0;
+    std::size_t x = i;
+    while (x < size_[L] && (x << (L * BITMAP_WORD_SHIFT)) < end) {
+      auto w = x / BITMAP_WORD_BITS;
+      auto b = x % BITMAP_WORD_BITS;
+      if (auto d = load(levels_[L][w], mm) >> b) {
+        x += std::countr_zero(d);
+        if (L == 0) {
+          return (x < end) ? x : e;
+        }
+        x <<= BITMAP_WORD_SHIFT;                // descend into word x
+        --L;
+      }
+      else if (++L < depth_) {
+        x = w + 1;                              // ascend past word w
+      }
+      else {
+        break;
+      }
+    }
+    return e;
+  }
+
+  /// Find the index of the next non-zero after `i`, saturating at `e`.
+  std::size_t next(std::size_t i, std::size_t e) const {
+    return (++i < e) ? first(i, e) : e;
+  }
+};
+}
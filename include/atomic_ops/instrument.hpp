@@ -0,0 +1,238 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#if !defined(ATOMIC_OPS_INSTRUMENT)
+#error "instrument.hpp is only used when ATOMIC_OPS_INSTRUMENT is defined"
+#endif
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <source_location>
+#include <vector>
+
+#if !defined(__x86_64__) && !defined(__i386__) && !defined(__aarch64__)
+#include <chrono>
+#endif
+
+/// Call-site instrumentation for the tagged primitives.
+///
+/// When ATOMIC_OPS_INSTRUMENT is defined every tagged primitive in
+/// atomic_ops.hpp and bitmap_ops.hpp takes a trailing defaulted
+/// std::source_location and records its call site in a thread-local table.
+/// Otherwise atomic_ops.hpp defines the macros below to expand to nothing.
+#define ATOMIC_OPS_SITE \
+  , std::source_location site = std::source_location::current()
+#define ATOMIC_OPS_SITE_ARG , site
+#define ATOMIC_OPS_PROBE(op, mm) \
+  ::atomic_ops::instrument_probe probe(site, op, mm)
+#define ATOMIC_OPS_CAS(ok) probe.cas(ok)
+
+namespace atomic_ops {
+/// The number of distinct sites that each thread records, later sites are
+/// dropped.
+static constexpr std::size_t INSTRUMENT_SITES = 1024;
+
+/// One in this many operations at each site is timed.
+static constexpr unsigned long INSTRUMENT_SAMPLE = 64;
+
+/// The counters for one operation at one call site.
+///
+/// `model` is the MemoryModel the operation used. The counters are written
+/// only by the owning thread, with relaxed stores so that they can be read
+/// while it runs.
+struct instrument_counters {
+  const char* file = nullptr;
+  const char* op = nullptr;
+  unsigned line = 0;
+  int model = 0;
+  unsigned long ops = 0;
+  unsigned long failures = 0;
+  unsigned long samples = 0;
+  unsigned long cycles = 0;
+};
+
+/// A thread's open-addressed table of sites.
+///
+/// Tables are never freed, so the counts of threads that have exited are still
+/// available to instrument_for_each.
+struct alignas(64) instrument_table {
+  instrument_counters sites[INSTRUMENT_SITES] = {};
+  instrument_table* next = nullptr;
+};
+
+inline constinit instrument_table* instrument_tables = nullptr;
+
+/// Read the cycle counter, rdtsc on x86 and cntvct_el0 on AArch64.
+inline std::uint64_t instrument_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+  std::uint64_t t;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(t));
+  return t;
+#else
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+inline instrument_table& instrument_local() {
+  thread_local instrument_table* table = [] {
+    auto* t = new instrument_table;
+    t->next = __atomic_load_n(&instrument_tables, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&instrument_tables, &t->next, t, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+    return t;
+  }();
+  return *table;
+}
+
+/// Find or insert the calling thread's counters for `op` at `site`.
+///
+/// The key fields are published by a release store of `op`, which is what
+/// instrument_for_each uses to recognize an occupied entry.
+inline instrument_counters& instrument_site(const std::source_location& site,
+                                            const char* op, int model) {
+  thread_local instrument_counters dropped;
+  auto& table = instrument_local();
+  auto h = reinterpret_cast<std::uintptr_t>(site.file_name()) ^
+           reinterpret_cast<std::uintptr_t>(op) ^
+           (std::uintptr_t(site.line()) * 0x9e3779b97f4a7c15u) ^ model;
+  for (std::size_t k = 0; k < INSTRUMENT_SITES; ++k) {
+    auto& c = table.sites[(h + k) % INSTRUMENT_SITES];
+    if (c.op == nullptr) {
+      c.file = site.file_name();
+      c.line = site.line();
+      c.model = model;
+      __atomic_store_n(&c.op, op, __ATOMIC_RELEASE);
+      return c;
+    }
+    if (c.op == op && c.file == site.file_name() && c.line == site.line() &&
+        c.model == model) {
+      return c;
+    }
+  }
+  return dropped;
+}
+
+/// Count one operation, and time it if it is a sampled one.
+class instrument_probe {
+  instrument_counters& c_;
+  std::uint64_t start_ = 0;
+
+  static void bump(unsigned long& u, unsigned long n = 1) {
+    __atomic_store_n(&u, u + n, __ATOMIC_RELAXED);
+  }
+
+ public:
+  instrument_probe(const std::source_location& site, const char* op,
+                   int model)
+      : c_(instrument_site(site, op, model)) {
+    bump(c_.ops);
+    if (c_.ops % INSTRUMENT_SAMPLE == 0) {
+      start_ = instrument_ticks();
+    }
+  }
+
+  ~instrument_probe() {
+    if (start_) {
+      bump(c_.cycles, instrument_ticks() - start_);
+      bump(c_.samples);
+    }
+  }
+
+  instrument_probe(const instrument_probe&) = delete;
+  instrument_probe& operator=(const instrument_probe&) = delete;
+
+  /// Record the result of a compare-and-swap attempt and pass it through.
+  bool cas(bool ok) {
+    if (!ok) {
+      bump(c_.failures);
+    }
+    return ok;
+  }
+};
+
+/// Call `f(c)` once per site with the counters summed over all threads.
+///
+/// Threads may still be running, in which case the counts are a consistent
+/// lower bound for each counter but not across counters.
+template <typename F>
+void instrument_for_each(F&& f) {
+  std::vector<instrument_counters> sites;
+  auto* t = __atomic_load_n(&instrument_tables, __ATOMIC_ACQUIRE);
+  for (; t; t = t->next) {
+    for (auto& c : t->sites) {
+      const char* op = __atomic_load_n(&c.op, __ATOMIC_ACQUIRE);
+      if (op == nullptr) {
+        continue;
+      }
+      instrument_counters* s = nullptr;
+      for (auto& u : sites) {
+        if (u.line == c.line && u.model == c.model &&
+            std::strcmp(u.op, op) == 0 && std::strcmp(u.file, c.file) == 0) {
+          s = &u;
+          break;
+        }
+      }
+      if (s == nullptr) {
+        s = &sites.emplace_back();
+        s->file = c.file;
+        s->op = op;
+        s->line = c.line;
+        s->model = c.model;
+      }
+      s->ops += __atomic_load_n(&c.ops, __ATOMIC_RELAXED);
+      s->failures += __atomic_load_n(&c.failures, __ATOMIC_RELAXED);
+      s->samples += __atomic_load_n(&c.samples, __ATOMIC_RELAXED);
+      s->cycles += __atomic_load_n(&c.cycles, __ATOMIC_RELAXED);
+    }
+  }
+  for (auto& s : sites) {
+    f(static_cast<const instrument_counters&>(s));
+  }
+}
+
+/// Write the summed counters as CSV, one row per site.
+///
+/// The model column uses the names of the mm_tag objects.
+inline void instrument_dump(std::FILE* out = stderr) {
+  static constexpr const char* models[] = {"sc", "rc", "xc", "unsync"};
+  std::fprintf(out, "file,line,op,model,ops,failures,samples,cycles_per_op\n");
+  instrument_for_each([&](const instrument_counters& c) {
+    double cycles = (c.samples) ? double(c.cycles) / c.samples : 0.0;
+    std::fprintf(out, "%s,%u,%s,%s,%lu,%lu,%lu,%.1f\n", c.file, c.line, c.op,
+                 models[c.model], c.ops, c.failures, c.samples, cycles);
+  });
+}
+}
@@ -0,0 +1,262 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include "atomic_ops.hpp"
+#include "bitmap_ops.hpp"
+#include "wait.hpp"
+#include <bit>
+#include <cstddef>
+#include <vector>
+
+namespace atomic_ops {
+/// The number of times a lock polls with cpu_relax() before it parks.
+static constexpr int LOCK_SPINS = 128;
+
+/// A test-and-test-and-set spinlock.
+///
+/// The word is 0 when free, 1 when held, and 2 when held and a thread may be
+/// parked. Waiters poll with relaxed loads and only CAS when the lock looks
+/// free, so the line is not bounced while it is held. After LOCK_SPINS polls
+/// a waiter marks the lock contended and parks with wait(), and unlock only
+/// calls notify_one() if it finds the lock marked.
+class alignas(CACHELINE_BYTES) spinlock {
+  unsigned word_ = 0;
+
+ public:
+  spinlock() = default;
+  spinlock(const spinlock&) = delete;
+  spinlock& operator=(const spinlock&) = delete;
+
+  bool try_lock() {
+    unsigned c = 0;
+    return load(word_, xc) == 0 && compare_exchange_strong(word_, c, 1u, rc);
+  }
+
+  void lock() {
+    for (int i = 0; i < LOCK_SPINS; ++i) {
+      if (try_lock()) {
+        return;
+      }
+      cpu_relax();
+    }
+    while (exchange(word_, 2u, rc) != 0) {
+      wait(word_, 2u, xc);
+    }
+  }
+
+  void unlock() {
+    if (exchange(word_, 0u, rc) == 2) {
+      notify_one(word_);
+    }
+  }
+};
+
+/// A FIFO ticket lock.
+///
+/// lock() takes a ticket with a relaxed fetch_add and waits for `serving_` to
+/// reach it, backing off in proportion to its distance from the head of the
+/// queue. Tickets advance in steps of 2 so that bit 0 of `serving_` can mark
+/// that a waiter has parked, which a waiter sets after LOCK_SPINS polls, and
+/// which tells unlock to clear it and call notify_all().
+class alignas(CACHELINE_BYTES) ticket_lock {
+  static constexpr unsigned PARKED = 1;
+  static constexpr unsigned TICKET = 2;
+
+  unsigned next_ = 0;
+  unsigned serving_ = 0;
+
+ public:
+  ticket_lock() = default;
+  ticket_lock(const ticket_lock&) = delete;
+  ticket_lock& operator=(const ticket_lock&) = delete;
+
+  bool try_lock() {
+    unsigned s = load(serving_, rc) & ~PARKED;
+    unsigned t = s;
+    return compare_exchange_strong(next_, t, s + TICKET, xc);
+  }
+
+  void lock() {
+    unsigned t = fetch_add(next_, TICKET, xc);
+    for (int i = 0;; ++i) {
+      unsigned s = load(serving_, rc);
+      if ((s & ~PARKED) == t) {
+        return;
+      }
+      if (i < LOCK_SPINS) {
+        for (unsigned k = (t - (s & ~PARKED)) / TICKET; k; --k) {
+          cpu_relax();
+        }
+        continue;
+      }
+      if ((s & PARKED) || compare_exchange_weak(serving_, s, s | PARKED, xc)) {
+        wait(serving_, s | PARKED, xc);
+      }
+    }
+  }
+
+  void unlock() {
+    if (fetch_add(serving_, TICKET, rc) & PARKED) {
+      fetch_and(serving_, ~PARKED, xc);
+      notify_all(serving_);
+    }
+  }
+};
+
+/// A writer-preferring reader-writer spinlock in a single word.
+///
+/// The word counts readers in units of READER above a WRITER bit and a PARKED
+/// bit. Readers enter with one fetch_add, and back out and wait if they find
+/// WRITER set. A writer claims WRITER with a CAS, which holds off new readers,
+/// and then waits for the readers that are already inside to leave. Waiters
+/// poll for LOCK_SPINS iterations before they set PARKED and park, and every
+/// update that could unblock a waiter clears PARKED and calls notify_all() if
+/// it was set.
+class alignas(CACHELINE_BYTES) rw_spinlock {
+  static constexpr unsigned WRITER = 1;
+  static constexpr unsigned PARKED = 2;
+  static constexpr unsigned READER = 4;
+
+  unsigned state_ = 0;
+
+  /// Wake the parked threads if `old`, the value before an update, had them.
+  void wake(unsigned old) {
+    if (old & PARKED) {
+      fetch_and(state_, ~PARKED, xc);
+      notify_all(state_);
+    }
+  }
+
+  /// Wait for the state to change from `s`, spinning first and then parking.
+  void pause(unsigned s, int& spins) {
+    if (spins < LOCK_SPINS) {
+      ++spins;
+      cpu_relax();
+    }
+    else if ((s & PARKED) ||
+             compare_exchange_weak(state_, s, s | PARKED, xc)) {
+      wait(state_, s | PARKED, xc);
+    }
+  }
+
+ public:
+  rw_spinlock() = default;
+  rw_spinlock(const rw_spinlock&) = delete;
+  rw_spinlock& operator=(const rw_spinlock&) = delete;
+
+  bool try_lock() {
+    unsigned s = 0;
+    return compare_exchange_strong(state_, s, WRITER, rc);
+  }
+
+  void lock() {
+    int spins = 0;
+    unsigned s = load(state_, xc);
+    while ((s & WRITER) || !compare_exchange_weak(state_, s, s | WRITER, rc)) {
+      if (s & WRITER) {
+        pause(s, spins);
+        s = load(state_, xc);
+      }
+    }
+    for (s = load(state_, rc); s >= READER; s = load(state_, rc)) {
+      pause(s, spins);
+    }
+  }
+
+  void unlock() {
+    wake(fetch_and(state_, ~WRITER, rc));
+  }
+
+  bool try_lock_shared() {
+    if (fetch_add(state_, READER, rc) & WRITER) {
+      wake(fetch_sub(state_, READER, rc));
+      return false;
+    }
+    return true;
+  }
+
+  void lock_shared() {
+    int spins = 0;
+    while (!try_lock_shared()) {
+      for (unsigned s = load(state_, xc); s & WRITER; s = load(state_, xc)) {
+        pause(s, spins);
+      }
+    }
+  }
+
+  void unlock_shared() {
+    wake(fetch_sub(state_, READER, rc));
+  }
+};
+
+static_assert(sizeof(spinlock) == CACHELINE_BYTES);
+static_assert(sizeof(ticket_lock) == CACHELINE_BYTES);
+static_assert(sizeof(rw_spinlock) == CACHELINE_BYTES);
+
+/// A power of two array of locks that stripes a bitmap by word.
+///
+/// for_word(w) and for_bit(i) map many words to each lock, so critical
+/// sections on different words usually take different locks, and since each
+/// lock is a cacheline they do not falsely share.
+template <typename Lock = spinlock>
+class striped_lock {
+  std::vector<Lock> locks_;
+  std::size_t mask_;
+
+ public:
+  /// Create at least `n` locks.
+  explicit striped_lock(std::size_t n)
+      : locks_(std::bit_ceil(n ? n : 1)), mask_(locks_.size() - 1) {
+  }
+
+  striped_lock(const striped_lock&) = delete;
+  striped_lock& operator=(const striped_lock&) = delete;
+
+  std::size_t size() const {
+    return locks_.size();
+  }
+
+  Lock& operator[](std::size_t k) {
+    return locks_[k & mask_];
+  }
+
+  /// The lock that covers the `w`th word of a bitmap.
+  Lock& for_word(std::size_t w) {
+    return locks_[w & mask_];
+  }
+
+  /// The lock that covers the word that holds bit `i` of a bitmap.
+  Lock& for_bit(std::size_t i) {
+    return for_word(i / BITMAP_WORD_BITS);
+  }
+};
+}
@@ -0,0 +1,358 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include "atomic_ops.hpp"
+#include "bitmap_ops.hpp"
+#include <cerrno>
+#include <cstddef>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace atomic_ops {
+/// The size of the huge pages requested for anonymous bitmaps.
+static constexpr std::size_t MAPPED_HUGE_PAGE_BYTES = 2 << 20;
+
+/// The offset of the words in a bitmap file, the header is in front of them.
+static constexpr std::size_t MAPPED_DATA_OFFSET = 4096;
+
+/// The header at the start of a bitmap file.
+///
+/// `header_checksum` covers the fields before it. `checksum` covers the words
+/// and is only valid when `sealed` is set, which mapped_bitmap::seal() does
+/// and opening the file for writing undoes.
+struct mapped_bitmap_header {
+  static constexpr std::uint64_t MAGIC = 0x70616d7469626f61;  // "aobitmap"
+  static constexpr std::uint32_t VERSION = 1;
+
+  std::uint64_t magic;
+  std::uint32_t version;
+  std::uint32_t word_bits;
+  std::uint64_t bits;
+  std::uint64_t sealed;
+  std::uint64_t checksum;
+  std::uint64_t header_checksum;
+};
+
+/// A 64 bit FNV-1a style hash of `n` words, a word at a time.
+template <std::unsigned_integral Word>
+std::uint64_t mapped_checksum(const Word* words, std::size_t n) {
+  std::uint64_t h = 0xcbf29ce484222325;
+  for (std::size_t i = 0; i < n; ++i) {
+    h = (h ^ std::uint64_t(words[i])) * 0x100000001b3;
+  }
+  return h;
+}
+
+/// The checksum of the fields before `header_checksum`, which are copied out
+/// as 64 bit words rather than read through a pointer of another type.
+inline std::uint64_t mapped_header_checksum(const mapped_bitmap_header& h) {
+  constexpr std::size_t n =
+      offsetof(mapped_bitmap_header, header_checksum) / sizeof(std::uint64_t);
+  std::uint64_t words[n];
+  std::memcpy(words, &h, sizeof(words));
+  return mapped_checksum(words, n);
+}
+
+/// A bitmap in a memory mapping, either anonymous and backed by huge pages
+/// where possible, or a file that persists across runs.
+///
+/// data() is the mapping itself, so the bitmap_* functions run on it with no
+/// copies, and reopening a file maps the bits that were last written back
+/// rather than rebuilding them. flush() writes a range back with msync, for
+/// checkpoints, and seal() records a checksum for a clean shutdown. This is
+/// POSIX only.
+template <MemoryModel MM = ReleaseConsistency>
+class mapped_bitmap {
+  static constexpr mm_tag<MM> mm = {};
+
+  std::size_t n_ = 0;
+  std::size_t bytes_ = 0;
+  void* map_ = nullptr;
+  mapped_bitmap_header* header_ = nullptr;
+  unsigned long* words_ = nullptr;
+  int fd_ = -1;
+  bool huge_ = false;
+  bool clean_ = false;
+
+  static std::size_t file_bytes(std::size_t n) {
+    return MAPPED_DATA_OFFSET + bitmap_words(n) * sizeof(unsigned long);
+  }
+
+  [[noreturn]] static void fail(const char* what) {
+    throw std::system_error(errno, std::generic_category(), what);
+  }
+
+  void map(std::size_t bytes, int flags, int fd) {
+    map_ = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, flags, fd, 0);
+    if (map_ == MAP_FAILED) {
+      map_ = nullptr;
+      fail("mmap");
+    }
+    bytes_ = bytes;
+  }
+
+  void write_header(bool sealed) {
+    header_->sealed = sealed;
+    header_->header_checksum = mapped_header_checksum(*header_);
+    if (msync(header_, MAPPED_DATA_OFFSET, MS_SYNC)) {
+      fail("msync");
+    }
+  }
+
+  void release() {
+    if (map_) {
+      munmap(map_, bytes_);
+    }
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+ public:
+  /// Create an empty anonymous bitmap of `n` bits.
+  ///
+  /// This tries MAP_HUGETLB first, which needs reserved huge pages, and
+  /// otherwise maps normal pages and asks for transparent huge pages with
+  /// madvise.
+  explicit mapped_bitmap(std::size_t n) : n_(n) {
+    std::size_t bytes = bitmap_words(n) * sizeof(unsigned long);
+    bytes = (bytes + MAPPED_HUGE_PAGE_BYTES - 1) / MAPPED_HUGE_PAGE_BYTES *
+            MAPPED_HUGE_PAGE_BYTES;
+    bytes = (bytes) ? bytes : MAPPED_HUGE_PAGE_BYTES;
+#if defined(MAP_HUGETLB)
+    map_ = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (map_ != MAP_FAILED) {
+      bytes_ = bytes;
+      huge_ = true;
+    }
+    else
+#endif
+    {
+      map(bytes, MAP_PRIVATE | MAP_ANONYMOUS, -1);
+#if defined(MADV_HUGEPAGE)
+      madvise(map_, bytes_, MADV_HUGEPAGE);
+#endif
+    }
+    words_ = static_cast<unsigned long*>(map_);
+  }
+
+  /// Open the bitmap file at `path`, creating it with `n` bits if it does not
+  /// exist.
+  ///
+  /// An existing file must have a valid header with this word width, and `n`
+  /// bits unless `n` is 0, which accepts the size in the header. If `verify`
+  /// is set and the file was sealed then its checksum is checked too. Opening
+  /// unseals the file, since the bitmap can now be written. With `n` 0 the
+  /// file is not created, so a missing file is an error that leaves nothing
+  /// behind.
+  explicit mapped_bitmap(const char* path, std::size_t n = 0,
+                         bool verify = false) {
+    fd_ = open(path, O_RDWR | O_CLOEXEC | ((n) ? O_CREAT : 0), 0644);
+    if (fd_ < 0) {
+      if (n == 0 && errno == ENOENT) {
+        throw std::invalid_argument("new bitmap file needs a size");
+      }
+      fail("open");
+    }
+
+    try {
+      struct stat st;
+      if (fstat(fd_, &st)) {
+        fail("fstat");
+      }
+
+      bool create = (st.st_size == 0);
+      if (create) {
+        if (n == 0) {
+          throw std::invalid_argument("new bitmap file needs a size");
+        }
+        st.st_size = file_bytes(n);
+        if (ftruncate(fd_, st.st_size)) {
+          fail("ftruncate");
+        }
+      }
+      else if (std::size_t(st.st_size) < MAPPED_DATA_OFFSET) {
+        throw std::runtime_error("bitmap file is truncated");
+      }
+
+      map(st.st_size, MAP_SHARED, fd_);
+      header_ = static_cast<mapped_bitmap_header*>(map_);
+      words_ = reinterpret_cast<unsigned long*>(
+          static_cast<char*>(map_) + MAPPED_DATA_OFFSET);
+
+      if (create) {
+        header_->magic = mapped_bitmap_header::MAGIC;
+        header_->version = mapped_bitmap_header::VERSION;
+        header_->word_bits = BITMAP_WORD_BITS;
+        header_->bits = n;
+        header_->checksum = 0;
+        n_ = n;
+      }
+      else {
+        auto sum = mapped_header_checksum(*header_);
+        if (header_->magic != mapped_bitmap_header::MAGIC ||
+            header_->version != mapped_bitmap_header::VERSION ||
+            header_->header_checksum != sum) {
+          throw std::runtime_error("invalid bitmap file header");
+        }
+        if (header_->word_bits != BITMAP_WORD_BITS) {
+          throw std::runtime_error("bitmap file has a different word width");
+        }
+        if (n != 0 && header_->bits != n) {
+          throw std::runtime_error("bitmap file has a different size");
+        }
+        n_ = n = header_->bits;
+        if (bytes_ < file_bytes(n)) {
+          throw std::runtime_error("bitmap file is truncated");
+        }
+        clean_ = header_->sealed;
+        if (clean_ && verify && checksum() != header_->checksum) {
+          throw std::runtime_error("bitmap file checksum mismatch");
+        }
+      }
+      write_header(false);
+    }
+    catch (...) {
+      release();
+      throw;
+    }
+#if defined(MADV_HUGEPAGE)
+    madvise(map_, bytes_, MADV_HUGEPAGE);
+#endif
+  }
+
+  ~mapped_bitmap() {
+    release();
+  }
+
+  mapped_bitmap(const mapped_bitmap&) = delete;
+  mapped_bitmap& operator=(const mapped_bitmap&) = delete;
+
+  std::size_t size() const {
+    return n_;
+  }
+
+  unsigned long* data() {
+    return words_;
+  }
+
+  const unsigned long* data() const {
+    return words_;
+  }
+
+  /// True if an anonymous bitmap got MAP_HUGETLB pages.
+  bool huge_pages() const {
+    return huge_;
+  }
+
+  /// True if the file was sealed when it was opened.
+  bool clean() const {
+    return clean_;
+  }
+
+  /// The checksum of the words, which reads the whole bitmap.
+  std::uint64_t checksum() const {
+    return mapped_checksum(words_, bitmap_words(n_));
+  }
+
+  unsigned long get(std::size_t i) const {
+    return bitmap_get(words_, i, mm);
+  }
+
+  /// Set a bit, returning its previous value.
+  unsigned long set(std::size_t i) {
+    return bitmap_set(words_, i, mm);
+  }
+
+  /// Clear a bit, returning its previous value.
+  unsigned long clear(std::size_t i) {
+    return bitmap_clear(words_, i, mm);
+  }
+
+  /// Find the first set bit at or after `i`, saturating at size().
+  std::size_t first(std::size_t i = 0) const {
+    return (i < n_) ? bitmap_first(words_, i, n_, mm) : n_;
+  }
+
+  /// Find the next set bit after `i`, saturating at size().
+  std::size_t next(std::size_t i) const {
+    return bitmap_next(words_, i, n_, mm);
+  }
+
+  /// Write the pages that contain the bits [i, e) back to the file.
+  ///
+  /// This does nothing for an anonymous bitmap.
+  void flush(std::size_t i, std::size_t e) {
+    e = (e < n_) ? e : n_;
+    if (fd_ < 0 || i >= e) {
+      return;
+    }
+    std::size_t page = sysconf(_SC_PAGESIZE);
+    auto* base = static_cast<char*>(map_);
+    std::size_t w = i / BITMAP_WORD_BITS;
+    std::size_t b = MAPPED_DATA_OFFSET + w * sizeof(unsigned long);
+    std::size_t c = file_bytes(e);
+    b = b / page * page;
+    if (msync(base + b, c - b, MS_SYNC)) {
+      fail("msync");
+    }
+  }
+
+  /// Write the whole bitmap back to the file.
+  void flush() {
+    flush(0, n_);
+  }
+
+  /// Write the bitmap back and mark the file clean with its checksum.
+  ///
+  /// Writers must be quiescent, and the bitmap should not be written after
+  /// this, since the file would then claim a checksum that no longer matches.
+  void seal() {
+    if (fd_ < 0) {
+      return;
+    }
+    flush();
+    header_->checksum = checksum();
+    write_header(true);
+    clean_ = true;
+  }
+};
+}
@@ -0,0 +1,222 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include "atomic_ops.hpp"
+#include "wait.hpp"
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace atomic_ops {
+/// A bounded multi-producer multi-consumer queue.
+///
+/// This is Dmitry Vyukov's design, where each cell carries a sequence number
+/// that says whether it is ready for the producer or the consumer at a given
+/// position, so producers and consumers only contend on their own index. The
+/// head and tail indices sit on separate cachelines.
+///
+/// The cell handoff uses the load and store orders of `MM`, which must be
+/// ReleaseConsistency or stronger, or Unsynchronized for queues that are only
+/// used by one thread at a time. When `Blocking` is true, each push and pop
+/// notifies the cell it publishes, so that push() and pop() can wait() instead
+/// of spinning when the queue is full or empty.
+template <typename T, MemoryModel MM = ReleaseConsistency,
+          bool Blocking = false>
+class mpmc_queue {
+  static_assert(MM != RelaxedConsistency,
+                "mpmc_queue needs release/acquire to hand off its values");
+  static_assert(!Blocking || MM != Unsynchronized,
+                "a blocking mpmc_queue cannot be Unsynchronized");
+
+  static constexpr MemoryModel INDEX_MM =
+      (MM == ReleaseConsistency) ? RelaxedConsistency : MM;
+  static constexpr mm_tag<MM> mm = {};
+  static constexpr mm_tag<INDEX_MM> index_mm = {};
+
+  struct cell {
+    std::size_t seq;
+    T value;
+  };
+
+  alignas(CACHELINE_BYTES) std::size_t tail_ = 0;
+  alignas(CACHELINE_BYTES) std::size_t head_ = 0;
+  alignas(CACHELINE_BYTES) std::size_t mask_;
+  std::unique_ptr<cell[]> cells_;
+
+  static std::intptr_t diff(std::size_t a, std::size_t b) {
+    return std::intptr_t(a - b);
+  }
+
+  cell& at(std::size_t pos) const {
+    return cells_[pos & mask_];
+  }
+
+  void publish(cell& c, std::size_t seq) {
+    store(c.seq, seq, mm);
+    if constexpr (Blocking) {
+      notify_all(c.seq);
+    }
+  }
+
+  /// Claim up to `n` consecutive cells whose sequence number is `pos + off`
+  /// at position `pos`, advancing `index`. Returns the first position and the
+  /// number of cells that were claimed.
+  std::pair<std::size_t, std::size_t> claim(std::size_t& index,
+                                            std::size_t off, std::size_t n) {
+    std::size_t pos = load(index, index_mm);
+    while (true) {
+      auto d = diff(load(at(pos).seq, mm), pos + off);
+      if (d < 0) {
+        return { pos, 0 };                      // full or empty
+      }
+      if (d > 0) {
+        pos = load(index, index_mm);            // lost a race, reload
+        continue;
+      }
+
+      std::size_t k = 1;
+      while (k < n && load(at(pos + k).seq, mm) == pos + k + off) {
+        ++k;
+      }
+      if (compare_exchange_weak(index, pos, pos + k, index_mm)) {
+        return { pos, k };
+      }
+    }
+  }
+
+  void wait_on(std::size_t& index, std::size_t off) {
+    if constexpr (Blocking) {
+      std::size_t pos = load(index, index_mm);
+      std::size_t seq = load(at(pos).seq, mm);
+      if (diff(seq, pos + off) < 0) {
+        wait(at(pos).seq, seq, mm);
+      }
+    }
+    else {
+      std::this_thread::yield();
+    }
+  }
+
+ public:
+  /// Create a queue that holds at least `capacity` values.
+  explicit mpmc_queue(std::size_t capacity)
+      : mask_(std::bit_ceil(capacity < 2 ? 2 : capacity) - 1),
+        cells_(new cell[mask_ + 1])
+  {
+    for (std::size_t i = 0; i <= mask_; ++i) {
+      cells_[i].seq = i;
+    }
+  }
+
+  mpmc_queue(const mpmc_queue&) = delete;
+  mpmc_queue& operator=(const mpmc_queue&) = delete;
+
+  std::size_t capacity() const {
+    return mask_ + 1;
+  }
+
+  /// Push a value, returning false if the queue is full.
+  template <typename U>
+  bool try_push(U&& u) {
+    auto [pos, k] = claim(tail_, 0, 1);
+    if (k == 0) {
+      return false;
+    }
+    at(pos).value = std::forward<U>(u);
+    publish(at(pos), pos + 1);
+    return true;
+  }
+
+  /// Pop a value into `out`, returning false if the queue is empty.
+  bool try_pop(T& out) {
+    auto [pos, k] = claim(head_, 1, 1);
+    if (k == 0) {
+      return false;
+    }
+    out = std::move(at(pos).value);
+    publish(at(pos), pos + mask_ + 1);
+    return true;
+  }
+
+  /// Push up to `n` values from `first` with a single claim of the tail.
+  ///
+  /// Returns the number of values that were pushed.
+  template <typename It>
+  std::size_t try_push_n(It first, std::size_t n) {
+    if (n == 0) {
+      return 0;
+    }
+    auto [pos, k] = claim(tail_, 0, n);
+    for (std::size_t j = 0; j < k; ++j, ++first) {
+      at(pos + j).value = *first;
+      publish(at(pos + j), pos + j + 1);
+    }
+    return k;
+  }
+
+  /// Pop up to `n` values into `out` with a single claim of the head.
+  ///
+  /// Returns the number of values that were popped.
+  template <typename It>
+  std::size_t try_pop_n(It out, std::size_t n) {
+    if (n == 0) {
+      return 0;
+    }
+    auto [pos, k] = claim(head_, 1, n);
+    for (std::size_t j = 0; j < k; ++j, ++out) {
+      *out = std::move(at(pos + j).value);
+      publish(at(pos + j), pos + j + mask_ + 1);
+    }
+    return k;
+  }
+
+  /// Push a value, waiting while the queue is full.
+  template <typename U>
+  void push(U&& u) {
+    while (!try_push(std::forward<U>(u))) {
+      wait_on(tail_, 0);
+    }
+  }
+
+  /// Pop a value, waiting while the queue is empty.
+  T pop() {
+    T out;
+    while (!try_pop(out)) {
+      wait_on(head_, 1);
+    }
+    return out;
+  }
+};
+}
@@ -0,0 +1,435 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include "atomic_ops.hpp"
+#include "bitmap_ops.hpp"
+#include "bitmap_parallel.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace atomic_ops {
+/// The largest NUMA node id that the placement masks can name.
+static constexpr int NUMA_MAX_NODES = 1024;
+
+/// Parse a sysfs list like "0-3,8,10-11", appending the ids to `out`.
+inline bool parse_id_list(const char* path, std::vector<int>& out) {
+  std::FILE* f = std::fopen(path, "r");
+  if (!f) {
+    return false;
+  }
+  int a, b;
+  while (std::fscanf(f, "%d", &a) == 1) {
+    b = a;
+    int c = std::fgetc(f);
+    if (c == '-') {
+      if (std::fscanf(f, "%d", &b) != 1) {
+        break;
+      }
+      c = std::fgetc(f);
+    }
+    for (; a <= b; ++a) {
+      out.push_back(a);
+    }
+    if (c != ',') {
+      break;
+    }
+  }
+  std::fclose(f);
+  return !out.empty();
+}
+
+/// The ids of the online NUMA nodes, or just node 0 if they are unknown.
+inline std::vector<int> numa_nodes() {
+  std::vector<int> nodes;
+  if (!parse_id_list("/sys/devices/system/node/online", nodes)) {
+    nodes.assign(1, 0);
+  }
+  return nodes;
+}
+
+/// The CPUs of NUMA node `node`, or every CPU if they are unknown.
+inline std::vector<int> numa_node_cpus(int node) {
+  std::vector<int> cpus;
+  char path[64];
+  std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+                node);
+  if (!parse_id_list(path, cpus)) {
+    cpus.clear();
+    for (unsigned i = 0, e = std::thread::hardware_concurrency(); i < e; ++i) {
+      cpus.push_back(int(i));
+    }
+  }
+  return cpus;
+}
+
+/// The NUMA node that the calling thread is running on.
+inline int this_numa_node() {
+#if defined(__linux__)
+  unsigned cpu, node;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+    return int(node);
+  }
+#endif
+  return 0;
+}
+
+/// Bind the calling thread to the CPUs of NUMA node `node`.
+inline void bind_to_numa_node(int node) {
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : numa_node_cpus(node)) {
+    CPU_SET(cpu, &set);
+  }
+  sched_setaffinity(0, sizeof(set), &set);
+#else
+  (void)node;
+#endif
+}
+
+/// How the pages of a numa_bitmap are spread across its nodes.
+enum NumaLayout {
+  Partitioned,                                  // contiguous range per node
+  Interleaved                                   // pages round-robin
+};
+
+/// The schedule of a numa_pool, with one queue of chunks per node.
+///
+/// Each thread first claims the chunks that the caller assigned to its own
+/// node and then helps with the chunks of the other nodes, so chunks are
+/// mostly processed next to their memory but an idle node never waits on a
+/// busy one. Workers bind themselves to the CPUs of their node.
+class numa_schedule {
+  struct alignas(CACHELINE_BYTES) queue {
+    std::vector<std::size_t> chunks;
+    std::size_t next = 0;
+  };
+
+  std::vector<int> nodes_;
+  std::vector<queue> queues_;
+
+  std::size_t slot(int node) const {
+    for (std::size_t k = 0; k < nodes_.size(); ++k) {
+      if (nodes_[k] == node) {
+        return k;
+      }
+    }
+    return std::size_t(node) % nodes_.size();
+  }
+
+ public:
+  explicit numa_schedule(std::vector<int> nodes)
+      : nodes_(std::move(nodes)), queues_(nodes_.size()) {
+  }
+
+  const std::vector<int>& nodes() const {
+    return nodes_;
+  }
+
+  /// Queue each chunk `i` in [0, n) on the node `owner(i)`.
+  template <typename Owner>
+  void reset(std::size_t n, Owner&& owner) {
+    for (auto& q : queues_) {
+      q.chunks.clear();
+      q.next = 0;
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+      queues_[slot(owner(i))].chunks.push_back(i);
+    }
+  }
+
+  void enter(std::size_t home) {
+    bind_to_numa_node(nodes_[home]);
+  }
+
+  std::size_t home() const {
+    return slot(this_numa_node());
+  }
+
+  template <typename Run>
+  void drain(std::size_t home, Run&& run) {
+    for (std::size_t k = 0; k < queues_.size(); ++k) {
+      auto& q = queues_[(home + k) % queues_.size()];
+      for (std::size_t i; (i = fetch_add(q.next, 1, xc)) < q.chunks.size();) {
+        run(q.chunks[i]);
+      }
+    }
+  }
+};
+
+/// A thread pool with workers bound to each NUMA node.
+///
+/// This is the worker_pool of thread_pool with a numa_schedule.
+class numa_pool : worker_pool<numa_schedule> {
+ public:
+  /// Create a pool with one worker per CPU of each of `nodes`, less one for
+  /// the calling thread, which also runs chunks.
+  explicit numa_pool(std::vector<int> nodes = numa_nodes())
+      : worker_pool(std::move(nodes)) {
+    std::size_t threads = 0;
+    auto& ids = schedule_.nodes();
+    for (std::size_t k = 0; k < ids.size(); ++k) {
+      for (std::size_t i = 0, e = numa_node_cpus(ids[k]).size(); i < e; ++i) {
+        if (threads++) {
+          spawn(k);
+        }
+      }
+    }
+  }
+
+  /// Run `f(i)` for each chunk `i` in [0, n), preferring a thread on the node
+  /// `owner(i)`.
+  ///
+  /// A call from inside one of this pool's own tasks runs the chunks inline,
+  /// since the workers that it would wait for are busy running the caller.
+  template <typename Owner, typename F>
+  void operator()(std::size_t n, Owner&& owner, F&& f) {
+    dispatch(n, [&](numa_schedule& s) { s.reset(n, owner); }, f);
+  }
+
+  static numa_pool& global() {
+    static numa_pool pool;
+    return pool;
+  }
+};
+
+/// An executor for the parallel bitmap operations that runs each chunk on
+/// the node that owns its words, for a `Layout` with a chunk_node(i) method.
+template <typename Layout>
+struct numa_executor {
+  numa_pool& pool;
+  const Layout& layout;
+
+  template <typename F>
+  void operator()(std::size_t n, F&& f) const {
+    pool(n, [this](std::size_t i) { return layout.chunk_node(i); }, f);
+  }
+};
+
+/// A bitmap whose storage is placed across NUMA nodes.
+///
+/// The words are page-aligned and zero, and each page is bound to one of
+/// `nodes`. The Partitioned layout binds one contiguous range per node with
+/// MPOL_PREFERRED, and the Interleaved layout binds the whole mapping with a
+/// single MPOL_INTERLEAVE over all of the nodes, so neither splits the mapping
+/// into more than one region per node. The binding is a preference, so a node
+/// that is full falls back to another node rather than failing. If the kernel
+/// rejects a binding, for instance because it has no NUMA support or the
+/// process may not set policies, the bitmap is simply page-aligned and
+/// placed() is false. data() can be used with the bitmap_* functions as usual,
+/// and node_of() maps a bit to the node that owns it.
+template <MemoryModel MM = ReleaseConsistency>
+class numa_bitmap {
+  static constexpr mm_tag<MM> mm = {};
+
+  std::size_t n_;
+  std::size_t page_words_;
+  std::size_t pages_;
+  std::size_t offset_ = 0;
+  unsigned long* words_;
+  std::vector<int> nodes_;
+  NumaLayout layout_;
+  int error_ = 0;
+
+  /// The node of page `p`. The kernel interleaves by virtual page number over
+  /// the nodes in the mask in increasing order, so the interleaved nodes are
+  /// kept sorted and `offset_` is the interleave position of the first page.
+  int page_node(std::size_t p) const {
+    auto k = nodes_.size();
+    return nodes_[(layout_ == Interleaved) ? (p + offset_) % k
+                                           : p * k / pages_];
+  }
+
+#if defined(__linux__)
+  /// Apply `policy` over `nodes` to the pages [p, q), recording the first
+  /// error.
+  void bind(std::size_t p, std::size_t q, const int* nodes, std::size_t k,
+            int policy) {
+    unsigned long mask[NUMA_MAX_NODES / BITMAP_WORD_BITS] = {};
+    for (std::size_t i = 0; i < k; ++i) {
+      if (nodes[i] < 0 || nodes[i] >= NUMA_MAX_NODES) {
+        error_ = (error_) ? error_ : EINVAL;
+        return;
+      }
+      bitmap_set(mask, nodes[i], unsync);
+    }
+    std::size_t bytes = page_words_ * sizeof(unsigned long);
+    if (syscall(SYS_mbind, words_ + p * page_words_, (q - p) * bytes, policy,
+                mask, NUMA_MAX_NODES + 1, 0) != 0) {
+      error_ = (error_) ? error_ : errno;
+    }
+  }
+#endif
+
+ public:
+  /// Create an empty bitmap of `n` bits placed across `nodes`.
+  explicit numa_bitmap(std::size_t n, NumaLayout layout = Partitioned,
+                       std::vector<int> nodes = numa_nodes())
+      : n_(n), nodes_(std::move(nodes)), layout_(layout) {
+    if (nodes_.empty()) {
+      nodes_.assign(1, 0);
+    }
+    if (layout_ == Interleaved) {
+      std::sort(nodes_.begin(), nodes_.end());
+      nodes_.erase(std::unique(nodes_.begin(), nodes_.end()), nodes_.end());
+    }
+#if defined(__linux__)
+    std::size_t page = sysconf(_SC_PAGESIZE);
+#else
+    std::size_t page = 4096;
+#endif
+    page_words_ = page / sizeof(unsigned long);
+    pages_ = (bitmap_words(n) + page_words_ - 1) / page_words_;
+    pages_ = (pages_) ? pages_ : 1;
+#if defined(__linux__)
+    void* p = mmap(nullptr, pages_ * page, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    words_ = static_cast<unsigned long*>(p);
+    if (layout_ == Interleaved) {
+      offset_ = reinterpret_cast<std::uintptr_t>(p) / page % nodes_.size();
+      bind(0, pages_, nodes_.data(), nodes_.size(), MPOL_INTERLEAVE);
+    }
+    else {
+      for (std::size_t i = 0, j = 1; i < pages_; i = j++) {
+        while (j < pages_ && page_node(j) == page_node(i)) {
+          ++j;
+        }
+        int node = page_node(i);
+        bind(i, j, &node, 1, MPOL_PREFERRED);
+      }
+    }
+#else
+    error_ = ENOSYS;
+    words_ = static_cast<unsigned long*>(
+        ::operator new(pages_ * page, std::align_val_t(page)));
+    std::fill_n(words_, pages_ * page_words_, 0ul);
+#endif
+  }
+
+  ~numa_bitmap() {
+#if defined(__linux__)
+    munmap(words_, pages_ * page_words_ * sizeof(unsigned long));
+#else
+    ::operator delete(words_, std::align_val_t(page_words_ *
+                                               sizeof(unsigned long)));
+#endif
+  }
+
+  numa_bitmap(const numa_bitmap&) = delete;
+  numa_bitmap& operator=(const numa_bitmap&) = delete;
+
+  std::size_t size() const {
+    return n_;
+  }
+
+  unsigned long* data() {
+    return words_;
+  }
+
+  const unsigned long* data() const {
+    return words_;
+  }
+
+  const std::vector<int>& nodes() const {
+    return nodes_;
+  }
+
+  /// Check that every page was bound as requested.
+  bool placed() const {
+    return error_ == 0;
+  }
+
+  /// The errno of the first binding that failed, or 0 if placed().
+  int placement_error() const {
+    return error_;
+  }
+
+  /// The node that owns bit `i`.
+  int node_of(std::size_t i) const {
+    return page_node(i / BITMAP_WORD_BITS / page_words_);
+  }
+
+  /// The node that owns chunk `i` of the parallel bitmap operations.
+  int chunk_node(std::size_t i) const {
+    return page_node(i * BITMAP_CHUNK_WORDS / page_words_);
+  }
+
+  /// An executor for bitmap_for_each_parallel and bitmap_count_parallel on
+  /// data() that runs each chunk on its own node.
+  numa_executor<numa_bitmap> executor(numa_pool& pool = numa_pool::global())
+      const {
+    return {pool, *this};
+  }
+
+  unsigned long get(std::size_t i) const {
+    return bitmap_get(words_, i, mm);
+  }
+
+  /// Set a bit, returning its previous value.
+  unsigned long set(std::size_t i) {
+    return bitmap_set(words_, i, mm);
+  }
+
+  /// Clear a bit, returning its previous value.
+  unsigned long clear(std::size_t i) {
+    return bitmap_clear(words_, i, mm);
+  }
+
+  /// Find the first set bit at or after `i`, saturating at size().
+  std::size_t first(std::size_t i = 0) const {
+    return (i < n_) ? bitmap_first(words_, i, n_, mm) : n_;
+  }
+
+  /// Find the next set bit after `i`, saturating at size().
+  std::size_t next(std::size_t i) const {
+    return bitmap_next(words_, i, n_, mm);
+  }
+};
+}
@@ -0,0 +1,153 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include "atomic_ops.hpp"
+#include "bitmap_ops.hpp"
+#include <cstddef>
+#include <vector>
+
+namespace atomic_ops {
+/// An array of `n` unsigned `Bits` bit fields packed into `Word`s.
+///
+/// `Bits` must divide the width of `Word` so that no field straddles two
+/// words. Reads are a single load. fetch_or and fetch_and are a single masked
+/// RMW on the field's word, which is the cheap way to drive monotone state
+/// transitions such as 0 -> 1 -> 3. set() uses the same RMWs when the new
+/// value is all zeros or all ones, and otherwise a CAS loop on the word, as
+/// does cas(). Fields in the same word never interfere with each other's
+/// values, although updates to them contend for the same cacheline.
+template <int Bits, bitmap_word Word = unsigned long,
+          MemoryModel MM = ReleaseConsistency>
+class packed_array {
+  static constexpr int WORD_BITS = bitmap_word_bits<Word>;
+  static_assert(0 < Bits && Bits <= WORD_BITS && WORD_BITS % Bits == 0,
+                "Bits must divide the width of Word");
+
+  static constexpr std::size_t FIELDS = WORD_BITS / Bits;
+  static constexpr mm_tag<MM> mm = {};
+
+ public:
+  /// The largest value that a field can hold, and the mask of field 0.
+  static constexpr Word MAX = Word(~Word(0)) >> (WORD_BITS - Bits);
+
+ private:
+  std::size_t n_;
+  std::vector<Word> words_;
+
+  static constexpr std::size_t word(std::size_t i) {
+    return i / FIELDS;
+  }
+
+  static constexpr int shift(std::size_t i) {
+    return i % FIELDS * Bits;
+  }
+
+ public:
+  /// Create an array of `n` zero fields.
+  explicit packed_array(std::size_t n)
+      : n_(n), words_((n + FIELDS - 1) / FIELDS) {
+  }
+
+  packed_array(const packed_array&) = delete;
+  packed_array& operator=(const packed_array&) = delete;
+
+  std::size_t size() const {
+    return n_;
+  }
+
+  /// The words of the array, FIELDS fields per word with field 0 lowest.
+  const Word* data() const {
+    return words_.data();
+  }
+
+  Word get(std::size_t i) const {
+    return (load(words_[word(i)], mm) >> shift(i)) & MAX;
+  }
+
+  /// Set field `i` to `v`, returning its previous value.
+  Word set(std::size_t i, Word v) {
+    auto& d = words_[word(i)];
+    auto s = shift(i);
+    Word m = MAX << s;
+    v &= MAX;
+    if (v == 0) {
+      return (atomic_ops::fetch_and(d, Word(~m), mm) >> s) & MAX;
+    }
+    if (v == MAX) {
+      return (atomic_ops::fetch_or(d, m, mm) >> s) & MAX;
+    }
+    Word old = load(d, xc);
+    while (!compare_exchange_weak(d, old, Word((old & ~m) | (v << s)), mm)) {
+    }
+    return (old >> s) & MAX;
+  }
+
+  /// Replace field `i` with `desired` if it equals `expected`.
+  ///
+  /// On failure `expected` is updated with the current value of the field.
+  /// Changes to the other fields of the word are retried rather than
+  /// reported, so this only fails when field `i` itself differs. The word is
+  /// first read with the load order of MM, so a failure that returns without
+  /// an RMW still acquires the value that it reports.
+  bool cas(std::size_t i, Word& expected, Word desired) {
+    auto& d = words_[word(i)];
+    auto s = shift(i);
+    Word m = MAX << s;
+    Word old = load(d, mm);
+    do {
+      if (((old >> s) & MAX) != expected) {
+        expected = (old >> s) & MAX;
+        return false;
+      }
+    } while (!compare_exchange_weak(d, old,
+                                    Word((old & ~m) | ((desired & MAX) << s)),
+                                    mm));
+    return true;
+  }
+
+  /// Atomically replace field `i` with `field | v`, returning its previous
+  /// value.
+  Word fetch_or(std::size_t i, Word v) {
+    auto s = shift(i);
+    return (atomic_ops::fetch_or(words_[word(i)], Word((v & MAX) << s), mm) >>
+            s) & MAX;
+  }
+
+  /// Atomically replace field `i` with `field & v`, returning its previous
+  /// value.
+  Word fetch_and(std::size_t i, Word v) {
+    auto s = shift(i);
+    Word m = Word(~((~v & MAX) << s));
+    return (atomic_ops::fetch_and(words_[word(i)], m, mm) >> s) & MAX;
+  }
+};
+}
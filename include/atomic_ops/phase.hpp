@@ -0,0 +1,103 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include "atomic_ops.hpp"
+#include "wait.hpp"
+
+namespace atomic_ops {
+/// A reusable sense-reversing barrier for a fixed number of threads.
+///
+/// Arriving threads count themselves in with an acq_rel fetch_add, and the
+/// last one resets the count and publishes the next phase with a release
+/// store, which the others wait() for with acquire. The barrier is therefore a
+/// complete release/acquire boundary, and everything that any thread wrote
+/// before it, with any model, is visible to every thread after it. The count
+/// and the phase live on separate cachelines so that waiters spinning on the
+/// phase are not disturbed by the arrivals.
+class phase_barrier {
+  alignas(CACHELINE_BYTES) unsigned count_ = 0;
+  alignas(CACHELINE_BYTES) unsigned phase_ = 0;
+  unsigned n_;
+
+ public:
+  /// Create a barrier for `n` threads.
+  explicit phase_barrier(unsigned n) : n_(n) {
+  }
+
+  phase_barrier(const phase_barrier&) = delete;
+  phase_barrier& operator=(const phase_barrier&) = delete;
+
+  unsigned size() const {
+    return n_;
+  }
+
+  /// The number of phases that have completed.
+  unsigned phase() const {
+    return load(phase_, rc);
+  }
+
+  /// Block until all `n` threads have arrived.
+  ///
+  /// Returns true in exactly one of the threads, the last to arrive, in each
+  /// phase.
+  bool arrive_and_wait() {
+    // Our previous arrival returned only after observing this phase, and the
+    // phase cannot advance again until we arrive, so a relaxed load is exact.
+    unsigned p = load(phase_, xc);
+    if (fetch_add(count_, 1u, rc) + 1 == n_) {
+      store(count_, 0u, xc);
+      store(phase_, p + 1, rc);
+      notify_all(phase_);
+      return true;
+    }
+    wait(phase_, p, rc);
+    return false;
+  }
+};
+
+/// Run one phase of a bulk-synchronous algorithm.
+///
+/// Calls `f(mm_tag<MM>{})`, and then waits at `barrier`. Inside the phase `f`
+/// should pass the tag that it is given to the bitmap_* and fetch_* calls,
+/// so the phase model replaces the per-call model. The barrier orders the
+/// phase's updates against everything after it, so a phase that only
+/// concurrently updates, or only reads, needs no ordering of its own and
+/// RelaxedConsistency is enough. Unsynchronized is only correct if no word
+/// is written by one thread and accessed by another during the phase.
+///
+/// Returns true in one thread per phase, like phase_barrier::arrive_and_wait.
+template <MemoryModel MM, typename F>
+bool with_phase(phase_barrier& barrier, F&& f) {
+  f(mm_tag<MM>{});
+  return barrier.arrive_and_wait();
+}
+}
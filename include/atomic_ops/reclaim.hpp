@@ -0,0 +1,336 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include "atomic_ops.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace atomic_ops {
+/// The maximum number of threads that can participate in a domain at once.
+static constexpr std::size_t RECLAIM_MAX_THREADS = 128;
+
+/// The number of retired pointers that a thread buffers before reclaiming.
+static constexpr std::size_t RECLAIM_BATCH = 64;
+
+/// The number of hazard pointers that each thread owns.
+static constexpr std::size_t HAZARD_SLOTS = 4;
+
+struct retired_ptr {
+  void* p;
+  void (*deleter)(void*);
+  unsigned long epoch;
+};
+
+template <typename T>
+void delete_object(void* p) {
+  delete static_cast<T*>(p);
+}
+
+/// Claim an unused record for a participant.
+template <typename Record, std::size_t N>
+Record* claim_record(Record (&records)[N]) {
+  for (auto& r : records) {
+    unsigned long expected = 0;
+    if (load(r.in_use, xc) == 0 &&
+        compare_exchange_strong(r.in_use, expected, 1ul, rc)) {
+      return &r;
+    }
+  }
+  throw std::length_error("too many reclamation participants");
+}
+
+/// Epoch-based reclamation.
+///
+/// Each thread attaches an epoch_domain::participant, and brackets its reads
+/// of shared nodes with enter() and exit(), or an epoch_domain::guard. Nodes
+/// that have been unlinked are passed to retire(), tagged with the current
+/// global epoch, and are freed in batches once the global epoch has advanced
+/// twice past that, at which point no thread can still hold a reference. The
+/// global epoch only advances when every active thread has observed it.
+class epoch_domain {
+  struct alignas(CACHELINE_BYTES) record {
+    unsigned long epoch = 0;                    // (epoch << 1) | active
+    unsigned long in_use = 0;
+  };
+
+  alignas(CACHELINE_BYTES) unsigned long epoch_ = 0;
+  record records_[RECLAIM_MAX_THREADS];
+  std::mutex orphans_lock_;
+  std::vector<retired_ptr> orphans_;
+
+  void try_advance() {
+    unsigned long e = load(epoch_, sc);
+    for (auto& r : records_) {
+      unsigned long v = load(r.epoch, sc);
+      if ((v & 1) && (v >> 1) != e) {
+        return;
+      }
+    }
+    compare_exchange_strong(epoch_, e, e + 1, sc);
+  }
+
+  /// Free the pointers in `list` that were retired at least two epochs ago.
+  static void free_safe(std::vector<retired_ptr>& list, unsigned long e) {
+    auto it = std::partition(list.begin(), list.end(), [e](auto& r) {
+      return r.epoch + 2 > e;
+    });
+    for (auto i = it; i != list.end(); ++i) {
+      i->deleter(i->p);
+    }
+    list.erase(it, list.end());
+  }
+
+ public:
+  epoch_domain() = default;
+  epoch_domain(const epoch_domain&) = delete;
+  epoch_domain& operator=(const epoch_domain&) = delete;
+
+  /// Free everything that is left, once all participants have detached.
+  ~epoch_domain() {
+    for (auto& r : orphans_) {
+      r.deleter(r.p);
+    }
+  }
+
+  class participant {
+    epoch_domain& d_;
+    record* r_;
+    std::vector<retired_ptr> retired_;
+
+   public:
+    explicit participant(epoch_domain& d)
+        : d_(d), r_(claim_record(d.records_))
+    {
+      retired_.reserve(RECLAIM_BATCH);
+    }
+
+    /// Detach, handing anything that is not yet safe to free to the domain.
+    ~participant() {
+      reclaim();
+      {
+        std::lock_guard lock(d_.orphans_lock_);
+        d_.orphans_.insert(d_.orphans_.end(), retired_.begin(), retired_.end());
+      }
+      store(r_->in_use, 0ul, rc);
+    }
+
+    participant(const participant&) = delete;
+    participant& operator=(const participant&) = delete;
+
+    /// Begin a read-side critical section.
+    void enter() {
+      store(r_->epoch, (load(d_.epoch_, xc) << 1) | 1, xc);
+      thread_fence(sc);
+    }
+
+    /// End a read-side critical section.
+    void exit() {
+      store(r_->epoch, 0ul, rc);
+    }
+
+    template <typename T>
+    void retire(T* p) {
+      retire(p, delete_object<T>);
+    }
+
+    /// Retire a node that the caller has unlinked.
+    ///
+    /// The fence orders the unlink before the read of the epoch, so the node
+    /// cannot be tagged with an epoch older than one in which a reader could
+    /// still have found it.
+    void retire(void* p, void (*deleter)(void*)) {
+      thread_fence(sc);
+      retired_.push_back({ p, deleter, load(d_.epoch_, sc) });
+      if (retired_.size() >= RECLAIM_BATCH) {
+        reclaim();
+      }
+    }
+
+    /// Try to advance the epoch and free whatever is now safe.
+    void reclaim() {
+      d_.try_advance();
+      unsigned long e = load(d_.epoch_, rc);
+      free_safe(retired_, e);
+      if (std::unique_lock lock(d_.orphans_lock_, std::try_to_lock); lock) {
+        free_safe(d_.orphans_, e);
+      }
+    }
+  };
+
+  /// A scoped read-side critical section.
+  class guard {
+    participant& p_;
+
+   public:
+    explicit guard(participant& p) : p_(p) {
+      p_.enter();
+    }
+
+    ~guard() {
+      p_.exit();
+    }
+
+    guard(const guard&) = delete;
+    guard& operator=(const guard&) = delete;
+  };
+};
+
+/// Hazard pointer reclamation.
+///
+/// Each thread attaches a hazard_domain::participant, which owns HAZARD_SLOTS
+/// hazard pointers. protect() publishes a pointer that is read from a shared
+/// location in one of the slots, and retire() buffers unlinked nodes, which
+/// are freed in batches of RECLAIM_BATCH once no slot in the domain holds
+/// them.
+class hazard_domain {
+  struct alignas(CACHELINE_BYTES) record {
+    void* hazards[HAZARD_SLOTS] = {};
+    unsigned long in_use = 0;
+  };
+
+  record records_[RECLAIM_MAX_THREADS];
+  std::mutex orphans_lock_;
+  std::vector<retired_ptr> orphans_;
+
+  /// Free the pointers in `list` that are not in the sorted `hazards`.
+  static void free_safe(std::vector<retired_ptr>& list,
+                        const std::vector<void*>& hazards) {
+    auto it = std::partition(list.begin(), list.end(), [&](auto& r) {
+      return std::binary_search(hazards.begin(), hazards.end(), r.p);
+    });
+    for (auto i = it; i != list.end(); ++i) {
+      i->deleter(i->p);
+    }
+    list.erase(it, list.end());
+  }
+
+ public:
+  hazard_domain() = default;
+  hazard_domain(const hazard_domain&) = delete;
+  hazard_domain& operator=(const hazard_domain&) = delete;
+
+  ~hazard_domain() {
+    for (auto& r : orphans_) {
+      r.deleter(r.p);
+    }
+  }
+
+  class participant {
+    hazard_domain& d_;
+    record* r_;
+    std::vector<retired_ptr> retired_;
+
+   public:
+    explicit participant(hazard_domain& d)
+        : d_(d), r_(claim_record(d.records_))
+    {
+      retired_.reserve(RECLAIM_BATCH);
+    }
+
+    ~participant() {
+      for (std::size_t k = 0; k < HAZARD_SLOTS; ++k) {
+        clear(k);
+      }
+      reclaim();
+      {
+        std::lock_guard lock(d_.orphans_lock_);
+        d_.orphans_.insert(d_.orphans_.end(), retired_.begin(), retired_.end());
+      }
+      store(r_->in_use, 0ul, rc);
+    }
+
+    participant(const participant&) = delete;
+    participant& operator=(const participant&) = delete;
+
+    /// Read `src` and protect the result in hazard slot `k`.
+    ///
+    /// The pointer is re-read after it is published until it is stable, so
+    /// the returned node cannot be freed until the slot is cleared.
+    template <typename T>
+    T* protect(std::size_t k, T* const& src) {
+      T* p = load(src, xc);
+      while (true) {
+        store(r_->hazards[k], static_cast<void*>(p), xc);
+        thread_fence(sc);
+        T* q = load(src, rc);
+        if (q == p) {
+          return p;
+        }
+        p = q;
+      }
+    }
+
+    /// Release hazard slot `k`.
+    void clear(std::size_t k) {
+      store(r_->hazards[k], static_cast<void*>(nullptr), rc);
+    }
+
+    template <typename T>
+    void retire(T* p) {
+      retire(p, delete_object<T>);
+    }
+
+    void retire(void* p, void (*deleter)(void*)) {
+      retired_.push_back({ p, deleter, 0 });
+      if (retired_.size() >= RECLAIM_BATCH) {
+        reclaim();
+      }
+    }
+
+    /// Free every retired node that is not protected by any thread.
+    ///
+    /// The orphan lock is taken before the hazards are read, so a detaching
+    /// participant cannot add a node to the orphans that was protected after
+    /// the scan.
+    void reclaim() {
+      std::unique_lock lock(d_.orphans_lock_, std::try_to_lock);
+      thread_fence(sc);
+      std::vector<void*> hazards;
+      for (auto& r : d_.records_) {
+        for (auto& h : r.hazards) {
+          if (void* p = load(h, rc)) {
+            hazards.push_back(p);
+          }
+        }
+      }
+      std::sort(hazards.begin(), hazards.end());
+      free_safe(retired_, hazards);
+      if (lock) {
+        free_safe(d_.orphans_, hazards);
+      }
+    }
+  };
+};
+}
@@ -0,0 +1,116 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include "atomic_ops.hpp"
+#include <cstddef>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace atomic_ops {
+/// A small dense index for the calling thread, assigned round-robin.
+inline std::size_t this_thread_shard() {
+  static constinit std::size_t next = 0;
+  thread_local std::size_t index = fetch_add(next, 1, xc);
+  return index;
+}
+
+#if defined(__linux__)
+/// The CPU that the calling thread is running on, or its thread shard if the
+/// CPU is unknown.
+inline std::size_t this_cpu_shard() {
+  int cpu = sched_getcpu();
+  return (cpu < 0) ? this_thread_shard() : std::size_t(cpu);
+}
+#endif
+
+/// A counter that is spread across `Shards` cacheline-sized slots.
+///
+/// Increments only touch the caller's slot, using the memory model `MM`, so
+/// concurrent increments from different threads do not share a line. Reading
+/// the exact value sweeps all of the slots.
+template <MemoryModel MM = RelaxedConsistency, std::size_t Shards = 64,
+          typename T = unsigned long>
+class sharded_counter {
+  struct alignas(CACHELINE_BYTES) shard {
+    T value = 0;
+  };
+
+  shard shards_[Shards] = {};
+
+ public:
+  static constexpr mm_tag<MM> mm = {};
+
+  /// Add `u` to the calling thread's slot.
+  template <typename U>
+  void add(U u) {
+    add(u, this_thread_shard());
+  }
+
+  /// Add `u` to the slot selected by `hint`, e.g. this_cpu_shard().
+  template <typename U>
+  void add(U u, std::size_t hint) {
+    fetch_add(shards_[hint % Shards].value, u, mm);
+  }
+
+  /// Read the exact value by summing all of the slots.
+  T load() const {
+    T sum = 0;
+    for (auto& s : shards_) {
+      sum += atomic_ops::load(s.value, mm);
+    }
+    return sum;
+  }
+
+  /// Estimate the value from `k` slots, starting at the caller's slot.
+  ///
+  /// This scales the partial sum by Shards / k, so it is only accurate when
+  /// the increments are spread evenly across the slots.
+  T estimate(std::size_t k) const {
+    k = (k == 0) ? 1 : (k < Shards) ? k : Shards;
+    std::size_t i = this_thread_shard();
+    T sum = 0;
+    for (std::size_t j = 0; j < k; ++j) {
+      sum += atomic_ops::load(shards_[(i + j) % Shards].value, mm);
+    }
+    return sum * T(Shards) / T(k);
+  }
+
+  /// Clear all of the slots.
+  void reset() {
+    for (auto& s : shards_) {
+      store(s.value, T(0), mm);
+    }
+  }
+};
+}
@@ -0,0 +1,151 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include "atomic_ops.hpp"
+#include "bitmap_ops.hpp"
+#include <bit>
+#include <cstddef>
+#include <utility>
+
+namespace atomic_ops {
+/// A bitmap of `N` bits with storage sized at compile time.
+///
+/// Indices are unsigned, so the word and bit of an index are a shift and a
+/// mask, and the whole-bitmap operations are fully unrolled over the words.
+template <std::size_t N, MemoryModel MM = ReleaseConsistency>
+class alignas(CACHELINE_BYTES) static_bitmap {
+  static constexpr std::size_t WORDS =
+      (N + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS;
+  static constexpr std::size_t TAIL = N % BITMAP_WORD_BITS;
+  static constexpr unsigned long LAST = (TAIL) ? (1ul << TAIL) - 1 : ~0ul;
+  static constexpr mm_tag<MM> mm = {};
+
+  unsigned long words_[WORDS] = {};
+
+  static constexpr std::size_t word(std::size_t i) {
+    return i >> BITMAP_WORD_SHIFT;
+  }
+
+  static constexpr unsigned long mask(std::size_t i) {
+    return 1ul << (i & (BITMAP_WORD_BITS - 1));
+  }
+
+  /// Apply `op(word, index)` to every word and combine the results with `f`.
+  template <typename Op, typename F>
+  auto reduce(Op&& op, F&& f) const {
+    return [&]<std::size_t... I>(std::index_sequence<I...>) {
+      return f(op(load(words_[I], mm), I)...);
+    }(std::make_index_sequence<WORDS>());
+  }
+
+ public:
+  static_assert(N > 0);
+
+  static constexpr std::size_t size() {
+    return N;
+  }
+
+  unsigned long* data() {
+    return words_;
+  }
+
+  const unsigned long* data() const {
+    return words_;
+  }
+
+  unsigned long get(std::size_t i) const {
+    return load(words_[word(i)], mm) & mask(i);
+  }
+
+  /// Set a bit, returning its previous value.
+  unsigned long set(std::size_t i) {
+    return fetch_or(words_[word(i)], mask(i), mm) & mask(i);
+  }
+
+  /// Clear a bit, returning its previous value.
+  unsigned long clear(std::size_t i) {
+    return fetch_and(words_[word(i)], ~mask(i), mm) & mask(i);
+  }
+
+  bool any() const {
+    return reduce([](unsigned long d, std::size_t) { return d; },
+                  [](auto... d) { return (d | ...); }) != 0;
+  }
+
+  bool none() const {
+    return !any();
+  }
+
+  bool all() const {
+    return reduce([](unsigned long d, std::size_t w) {
+      return d == ((w == WORDS - 1) ? LAST : ~0ul);
+    }, [](auto... d) { return (d && ...); });
+  }
+
+  std::size_t count() const {
+    return reduce([](unsigned long d, std::size_t) {
+      return std::size_t(std::popcount(d));
+    }, [](auto... d) { return (d + ...); });
+  }
+
+  /// Find the index of the first non-zero at or after `i`, saturating at N.
+  std::size_t first(std::size_t i = 0) const {
+    if (i >= N) {
+      return N;
+    }
+
+    std::size_t w = word(i);
+    if (auto d = load(words_[w], mm) & ~(mask(i) - 1)) {
+      return (w << BITMAP_WORD_SHIFT) + std::countr_zero(d);
+    }
+
+    for (++w; w < WORDS; ++w) {
+      if (auto d = load(words_[w], mm)) {
+        return (w << BITMAP_WORD_SHIFT) + std::countr_zero(d);
+      }
+    }
+    return N;
+  }
+
+  /// Find the index of the next non-zero after `i`, saturating at N.
+  std::size_t next(std::size_t i) const {
+    return first(i + 1);
+  }
+
+  /// Clear every bit.
+  void reset() {
+    for (auto& d : words_) {
+      store(d, 0ul, mm);
+    }
+  }
+};
+}
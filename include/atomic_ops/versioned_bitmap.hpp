@@ -0,0 +1,182 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include "atomic_ops.hpp"
+#include "bitmap_ops.hpp"
+#include "wait.hpp"
+#include <cstddef>
+#include <vector>
+
+namespace atomic_ops {
+/// A bitmap whose readers take consistent per-block snapshots without RMWs.
+///
+/// The bits are divided into blocks of `BlockWords` words, one cacheline by
+/// default, and each block has a pair of stamps that count the writes that
+/// have begun and ended. A writer bumps `begin`, issues a release fence,
+/// updates the word with `MM`, and then bumps `end` with release. A reader
+/// loads `end` with acquire, copies the block, issues an acquire fence, and
+/// accepts the copy if `begin` still equals the `end` that it started with,
+/// which means that no write began or was in progress while it read. Writers
+/// never wait for each other or for readers, and readers only retry the blocks
+/// that were written while they were being read.
+///
+/// Each block is consistent on its own, snapshots that span several blocks are
+/// not an atomic snapshot of the whole range.
+template <MemoryModel MM = ReleaseConsistency, std::size_t BlockWords = 8>
+class versioned_bitmap {
+  static_assert(MM != Unsynchronized,
+                "versioned_bitmap requires an atomic memory model");
+  static_assert(BlockWords > 0);
+
+  static constexpr std::size_t BLOCK_BITS = BlockWords * BITMAP_WORD_BITS;
+  static constexpr mm_tag<MM> mm = {};
+
+  struct stamp {
+    unsigned long begin = 0;
+    unsigned long end = 0;
+  };
+
+  std::size_t n_;
+  std::vector<unsigned long> words_;
+  std::vector<stamp> stamps_;
+
+  /// Update bit `i` with `op(word, mask)`, bracketed by the block's stamps.
+  template <typename Op>
+  unsigned long write(std::size_t i, Op&& op) {
+    auto& s = stamps_[i / BLOCK_BITS];
+    fetch_add(s.begin, 1ul, relaxed);
+    thread_fence(release);
+    auto m = bitmap_mask(i % BITMAP_WORD_BITS);
+    auto old = op(words_[i / BITMAP_WORD_BITS], m);
+    fetch_add(s.end, 1ul, release);
+    return old & m;
+  }
+
+  /// Copy block `b` to `out`, retrying until no write overlaps the copy.
+  void read(std::size_t b, unsigned long* out) const {
+    auto& s = stamps_[b];
+    const unsigned long* p = words_.data() + b * BlockWords;
+    for (;;) {
+      auto e = load(s.end, acquire);
+      if (load(s.begin, relaxed) == e) {
+        for (std::size_t k = 0; k < BlockWords; ++k) {
+          out[k] = load(p[k], xc);
+        }
+        thread_fence(acquire);
+        if (load(s.begin, relaxed) == e) {
+          return;
+        }
+      }
+      cpu_relax();
+    }
+  }
+
+ public:
+  /// Create an empty bitmap of `n` bits.
+  explicit versioned_bitmap(std::size_t n)
+      : n_(n),
+        words_((n + BLOCK_BITS - 1) / BLOCK_BITS * BlockWords),
+        stamps_((n + BLOCK_BITS - 1) / BLOCK_BITS) {
+  }
+
+  versioned_bitmap(const versioned_bitmap&) = delete;
+  versioned_bitmap& operator=(const versioned_bitmap&) = delete;
+
+  std::size_t size() const {
+    return n_;
+  }
+
+  /// The words of the bitmap, which can be passed to the bitmap_* reads.
+  const unsigned long* data() const {
+    return words_.data();
+  }
+
+  unsigned long get(std::size_t i) const {
+    return bitmap_get(words_.data(), i, mm);
+  }
+
+  /// Set a bit, returning its previous value.
+  unsigned long set(std::size_t i) {
+    return write(i, [](unsigned long& w, unsigned long m) {
+      return fetch_or(w, m, mm);
+    });
+  }
+
+  /// Clear a bit, returning its previous value.
+  unsigned long clear(std::size_t i) {
+    return write(i, [](unsigned long& w, unsigned long m) {
+      return fetch_and(w, ~m, mm);
+    });
+  }
+
+  /// Copy the words that contain the bits [i, e) into the same words of `out`.
+  ///
+  /// Each block of the copy is consistent, blocks that were written during the
+  /// copy are reread.
+  void snapshot(std::size_t i, std::size_t e, unsigned long* out) const {
+    e = (e < n_) ? e : n_;
+    if (i >= e) {
+      return;
+    }
+
+    std::size_t w = i / BITMAP_WORD_BITS;
+    std::size_t v = (e - 1) / BITMAP_WORD_BITS + 1;
+    unsigned long block[BlockWords];
+    for (std::size_t b = w / BlockWords; w < v; ++b) {
+      read(b, block);
+      for (std::size_t u = (b + 1) * BlockWords; w < u && w < v; ++w) {
+        out[w] = block[w % BlockWords];
+      }
+    }
+  }
+
+  /// Find the first set bit at or after `i` in a consistent read of each
+  /// block, saturating at size().
+  std::size_t first(std::size_t i = 0) const {
+    unsigned long block[BlockWords];
+    for (std::size_t b = i / BLOCK_BITS; i < n_; i = ++b * BLOCK_BITS) {
+      read(b, block);
+      std::size_t k = bitmap_first(block, i % BLOCK_BITS, BLOCK_BITS, unsync);
+      if (k < BLOCK_BITS) {
+        k += b * BLOCK_BITS;
+        return (k < n_) ? k : n_;
+      }
+    }
+    return n_;
+  }
+
+  /// Find the next set bit after `i`, saturating at size().
+  std::size_t next(std::size_t i) const {
+    return first(i + 1);
+  }
+};
+}
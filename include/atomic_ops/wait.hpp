@@ -0,0 +1,183 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include "atomic_ops.hpp"
+#include <bit>
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <type_traits>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+namespace atomic_ops {
+/// The number of times wait() polls with cpu_relax() before yielding.
+static constexpr int WAIT_SPINS = 64;
+
+/// The number of times wait() polls with a yield before it blocks.
+static constexpr int WAIT_YIELDS = 16;
+
+/// The number of slots in the parking table used by wait() and notify.
+static constexpr int WAIT_TABLE_SIZE = 256;
+
+/// Hint to the processor that we are in a spin loop.
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  asm volatile("yield" ::: "memory");
+#elif defined(__powerpc__) || defined(__powerpc64__)
+  asm volatile("or 27,27,27" ::: "memory");
+#endif
+}
+
+#if defined(__linux__)
+/// A slot in the parking table.
+///
+/// Words that are not 4 bytes cannot be passed to futex directly, so their
+/// waiters sleep on the slot's sequence number instead, which notify bumps.
+/// The waiter count lets notify skip the system call when nobody is parked.
+struct alignas(CACHELINE_BYTES) wait_slot {
+  unsigned seq = 0;
+  unsigned waiters = 0;
+};
+
+inline wait_slot& wait_slot_for(const void* addr) {
+  static wait_slot table[WAIT_TABLE_SIZE];
+  auto key = reinterpret_cast<std::uintptr_t>(addr);
+  return table[((key >> 2) ^ (key >> 12)) % WAIT_TABLE_SIZE];
+}
+
+inline void futex_wait(const void* addr, unsigned val) {
+  syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, nullptr, nullptr, 0);
+}
+
+inline void futex_wake(const void* addr, int n) {
+  syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, n, nullptr, nullptr, 0);
+}
+#endif
+
+/// Block until `t` no longer holds `old`.
+///
+/// The value of `t` is read with the load order of `mm`. The caller spins for
+/// a while, then yields, and then parks in the operating system until another
+/// thread calls notify_one(t) or notify_all(t). `T` is deduced from `t` alone,
+/// so `old` can be a literal of another integer type.
+template <MemoryModel mm, typename T>
+void wait(T& t, std::type_identity_t<T> old, mm_tag<mm> = {}) {
+  static_assert(mm != Unsynchronized, "wait requires an atomic memory model");
+
+  for (int i = 0; i < WAIT_SPINS; ++i) {
+    if (load(t, mm_tag<mm>{}) != old) {
+      return;
+    }
+    cpu_relax();
+  }
+
+  for (int i = 0; i < WAIT_YIELDS; ++i) {
+    if (load(t, mm_tag<mm>{}) != old) {
+      return;
+    }
+    std::this_thread::yield();
+  }
+
+#if defined(__linux__)
+  auto& s = wait_slot_for(std::addressof(t));
+  fetch_add(s.waiters, 1u, sc);
+  while (true) {
+    unsigned seq = load(s.seq, sc);
+    if (load(t, mm_tag<mm>{}) != old) {
+      break;
+    }
+    if constexpr (sizeof(T) == 4) {
+      futex_wait(std::addressof(t), std::bit_cast<unsigned>(old));
+    }
+    else {
+      futex_wait(std::addressof(s.seq), seq);
+    }
+  }
+  fetch_sub(s.waiters, 1u, rc);
+#elif defined(_WIN32)
+  while (load(t, mm_tag<mm>{}) == old) {
+    WaitOnAddress(std::addressof(t), std::addressof(old), sizeof(T), INFINITE);
+  }
+#else
+  while (load(t, mm_tag<mm>{}) == old) {
+    std::this_thread::yield();
+  }
+#endif
+}
+
+/// Wake at least one thread that is blocked in wait(t).
+///
+/// Words that share a parking slot cannot be told apart, so on Linux this
+/// wakes all of the waiters for words that are not 4 bytes.
+template <typename T>
+void notify_one(T& t) {
+#if defined(__linux__)
+  auto& s = wait_slot_for(std::addressof(t));
+  fetch_add(s.seq, 1u, sc);
+  if (load(s.waiters, sc)) {
+    if constexpr (sizeof(T) == 4) {
+      futex_wake(std::addressof(t), 1);
+    }
+    else {
+      futex_wake(std::addressof(s.seq), INT_MAX);
+    }
+  }
+#elif defined(_WIN32)
+  WakeByAddressSingle(std::addressof(t));
+#endif
+}
+
+/// Wake all of the threads that are blocked in wait(t).
+template <typename T>
+void notify_all(T& t) {
+#if defined(__linux__)
+  auto& s = wait_slot_for(std::addressof(t));
+  fetch_add(s.seq, 1u, sc);
+  if (load(s.waiters, sc)) {
+    futex_wake((sizeof(T) == 4) ? static_cast<const void*>(std::addressof(t))
+                                : std::addressof(s.seq), INT_MAX);
+  }
+#elif defined(_WIN32)
+  WakeByAddressAll(std::addressof(t));
+#endif
+}
+}
@@ -0,0 +1,93 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include <atomic_ops/atomic_ops.hpp>
+#include <climits>
+#include <cstdint>
+#include "test.hpp"
+
+using namespace atomic_ops;
+using atomic_ops::test::THREADS;
+
+// The operand is converted to the type of the object before it is compared,
+// so mixed signedness compares the values that would be stored. This is also
+// built with ATOMIC_OPS_CAS_MIN_MAX, so the CAS loops and the builtins, where
+// the compiler has them, must give the same answers.
+template <MemoryModel MM>
+static void min_max() {
+  constexpr mm_tag<MM> mm = {};
+  int i = -1;
+  ATOMIC_OPS_CHECK(fetch_min(i, 0u, mm) == -1 && i == -1);
+  ATOMIC_OPS_CHECK(fetch_max(i, 0u, mm) == -1 && i == 0);
+  ATOMIC_OPS_CHECK(fetch_min(i, -5, mm) == 0 && i == -5);
+  ATOMIC_OPS_CHECK(fetch_max(i, 3l, mm) == -5 && i == 3);
+
+  unsigned u = 7;
+  ATOMIC_OPS_CHECK(fetch_max(u, -1, mm) == 7 && u == UINT_MAX);
+  ATOMIC_OPS_CHECK(fetch_min(u, 2, mm) == UINT_MAX && u == 2);
+  ATOMIC_OPS_CHECK(fetch_min(u, 9ull, mm) == 2 && u == 2);
+
+  std::uint8_t b = 10;
+  ATOMIC_OPS_CHECK(fetch_max(b, 300, mm) == 10 && b == 44);
+  ATOMIC_OPS_CHECK(fetch_min(b, std::uint8_t(3), mm) == 44 && b == 3);
+
+  std::int64_t l = 0;
+  ATOMIC_OPS_CHECK(fetch_min(l, INT64_MIN, mm) == 0 && l == INT64_MIN);
+  ATOMIC_OPS_CHECK(fetch_max(l, 1u, mm) == INT64_MIN && l == 1);
+}
+
+// Every thread offers its own range of values, and the result must be the
+// smallest and largest of all of them.
+template <MemoryModel MM>
+static void concurrent_min_max() {
+  constexpr long PER_THREAD = 20000;
+  long lo = 0;
+  long hi = 0;
+  test::run_threads(THREADS, [&](unsigned t) {
+    for (long k = 0; k < PER_THREAD; ++k) {
+      long v = (k % 2 ? -1 : 1) * (long(t) * PER_THREAD + k);
+      fetch_min(lo, v, mm_tag<MM>());
+      fetch_max(hi, v, mm_tag<MM>());
+    }
+  });
+  long top = long(THREADS) * PER_THREAD - 1;
+  ATOMIC_OPS_CHECK(lo == (top % 2 ? -top : -(top - 1)));
+  ATOMIC_OPS_CHECK(hi == (top % 2 ? top - 1 : top));
+}
+
+int main() {
+  min_max<SequentialConsistency>();
+  min_max<ReleaseConsistency>();
+  min_max<RelaxedConsistency>();
+  min_max<Unsynchronized>();
+  concurrent_min_max<SequentialConsistency>();
+  concurrent_min_max<ReleaseConsistency>();
+  concurrent_min_max<RelaxedConsistency>();
+}
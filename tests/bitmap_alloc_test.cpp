@@ -0,0 +1,167 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include <atomic_ops/bitmap_alloc.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "test.hpp"
+
+using namespace atomic_ops;
+using atomic_ops::test::THREADS;
+
+// Allocate single bits until the bitmap is exhausted, then free and reuse one.
+template <MemoryModel MM, bitmap_word Word>
+static void free_functions() {
+  constexpr std::size_t N = 200;
+  std::vector<Word> bits(bitmap_words<Word>(N));
+  std::vector<unsigned char> seen(N);
+  for (std::size_t k = 0; k < N; ++k) {
+    std::size_t i = bitmap_alloc(bits.data(), N, mm_tag<MM>());
+    ATOMIC_OPS_CHECK(i < N && !seen[i]);
+    seen[i] = 1;
+  }
+  ATOMIC_OPS_CHECK(bitmap_alloc(bits.data(), N, mm_tag<MM>()) == N);
+  ATOMIC_OPS_CHECK(bitmap_first_zero(bits.data(), std::size_t(0), N,
+                                     mm_tag<MM>()) == N);
+  bitmap_free(bits.data(), std::size_t(77), mm_tag<MM>());
+  ATOMIC_OPS_CHECK(bitmap_first_zero(bits.data(), std::size_t(0), N,
+                                     mm_tag<MM>()) == 77);
+  ATOMIC_OPS_CHECK(bitmap_first_zero(bits.data(), std::size_t(78), N,
+                                     mm_tag<MM>()) == N);
+  ATOMIC_OPS_CHECK(bitmap_alloc(bits.data(), N, mm_tag<MM>()) == 77);
+
+  // Runs of 70 bits cross word boundaries. The search starts at the thread's
+  // hint rather than at the first fit, so check that once it fails no run of
+  // K zeros is left.
+  constexpr std::size_t M = 300, K = 70;
+  std::vector<Word> runs(bitmap_words<Word>(M));
+  std::vector<std::size_t> got;
+  std::size_t i;
+  while ((i = bitmap_alloc(runs.data(), M, K, mm_tag<MM>())) < M) {
+    ATOMIC_OPS_CHECK(i + K <= M);
+    for (auto j : got) {
+      ATOMIC_OPS_CHECK(i + K <= j || j + K <= i);
+    }
+    got.push_back(i);
+  }
+  ATOMIC_OPS_CHECK(got.size() >= M / (2 * K));
+  for (std::size_t b = 0, run = 0; b < M; ++b) {
+    run = bitmap_get(runs.data(), b, unsync) ? 0 : run + 1;
+    ATOMIC_OPS_CHECK(run < K);
+  }
+  ATOMIC_OPS_CHECK(bitmap_alloc(runs.data(), M, M + 1, mm_tag<MM>()) == M);
+  bitmap_free(runs.data(), got[0], K, mm_tag<MM>());
+  ATOMIC_OPS_CHECK(bitmap_alloc(runs.data(), M, K, mm_tag<MM>()) < M);
+}
+
+template <MemoryModel MM>
+static void allocator() {
+  constexpr std::size_t N = 1000;
+  bitmap_allocator<MM> a(N);
+  ATOMIC_OPS_CHECK(a.size() == N);
+  std::vector<unsigned char> seen(N);
+  for (std::size_t k = 0; k < N; ++k) {
+    std::size_t i = a.alloc();
+    ATOMIC_OPS_CHECK(i < N && !seen[i]);
+    seen[i] = 1;
+  }
+  ATOMIC_OPS_CHECK(a.alloc() == N);
+  ATOMIC_OPS_CHECK(a.alloc(1) == N);
+  a.free(500);
+  ATOMIC_OPS_CHECK(a.alloc() == 500);
+
+  a.free(130, 100);
+  ATOMIC_OPS_CHECK(a.alloc(101) == N);
+  ATOMIC_OPS_CHECK(a.alloc(100) == 130);
+  ATOMIC_OPS_CHECK(a.alloc() == N);
+}
+
+// Threads allocate until the allocator is exhausted, and every bit must be
+// handed out exactly once. They then keep allocating and freeing, checking
+// that no bit is ever held by two threads at once.
+template <MemoryModel MM>
+static void exhaustion() {
+  constexpr std::size_t N = 10000;
+  constexpr int ROUNDS = 20000;
+  bitmap_allocator<MM> a(N);
+  std::vector<unsigned long> owner(N);
+
+  test::run_threads(THREADS, [&](unsigned t) {
+    std::vector<std::size_t> mine;
+    for (std::size_t i; (i = a.alloc()) < N;) {
+      ATOMIC_OPS_CHECK(exchange(owner[i], t + 1ul, rc) == 0);
+      mine.push_back(i);
+    }
+    for (auto i : mine) {
+      ATOMIC_OPS_CHECK(exchange(owner[i], 0ul, rc) == t + 1);
+      a.free(i);
+    }
+  });
+  for (std::size_t i = 0; i < N; ++i) {
+    ATOMIC_OPS_CHECK(owner[i] == 0);
+  }
+
+  test::run_threads(THREADS, [&](unsigned t) {
+    for (int r = 0; r < ROUNDS; ++r) {
+      std::size_t i = a.alloc();
+      ATOMIC_OPS_CHECK(i < N);
+      ATOMIC_OPS_CHECK(exchange(owner[i], t + 1ul, rc) == 0);
+      ATOMIC_OPS_CHECK(exchange(owner[i], 0ul, rc) == t + 1);
+      a.free(i);
+    }
+  });
+
+  std::size_t k = 0;
+  while (a.alloc() < N) {
+    ++k;
+  }
+  ATOMIC_OPS_CHECK(k == N);
+}
+
+template <bitmap_word Word>
+static void free_functions_models() {
+  free_functions<SequentialConsistency, Word>();
+  free_functions<ReleaseConsistency, Word>();
+  free_functions<RelaxedConsistency, Word>();
+  free_functions<Unsynchronized, Word>();
+}
+
+int main() {
+  free_functions_models<unsigned long>();
+  free_functions_models<std::uint32_t>();
+  allocator<SequentialConsistency>();
+  allocator<ReleaseConsistency>();
+  allocator<RelaxedConsistency>();
+  allocator<Unsynchronized>();
+  exhaustion<SequentialConsistency>();
+  exhaustion<ReleaseConsistency>();
+  exhaustion<RelaxedConsistency>();
+}
@@ -0,0 +1,377 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include <atomic_ops/bitmap_ops.hpp>
+#include <atomic_ops/bitmap_view.hpp>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "test.hpp"
+
+using namespace atomic_ops;
+
+// Every operation is checked against a plain vector<bool>, for each word type
+// and memory model, over a bitmap of a few scan blocks.
+template <bitmap_word Word>
+static constexpr std::size_t BLOCK_BITS =
+    std::size_t(bitmap_scan_words<Word>) * bitmap_word_bits<Word>;
+
+template <bitmap_word Word>
+static constexpr std::size_t N = 3 * BLOCK_BITS<Word> + 37;
+
+// The bits around each word and block boundary, where off-by-one errors in
+// the masks and loop bounds show up.
+template <bitmap_word Word>
+static std::vector<std::size_t> edges() {
+  constexpr std::size_t W = bitmap_word_bits<Word>;
+  std::vector<std::size_t> e = {0, 1};
+  for (std::size_t b = W; b < N<Word>; b += W) {
+    for (std::size_t d : {b - 1, b, b + 1}) {
+      if (d < N<Word> && (b % BLOCK_BITS<Word> == 0 || b < 3 * W)) {
+        e.push_back(d);
+      }
+    }
+  }
+  e.push_back(N<Word> - 1);
+  e.push_back(N<Word>);
+  return e;
+}
+
+template <bitmap_word Word>
+static void check_equal(const std::vector<Word>& bits,
+                        const std::vector<bool>& ref) {
+  for (std::size_t i = 0; i < ref.size(); ++i) {
+    ATOMIC_OPS_CHECK(!bitmap_get(bits.data(), i, unsync) == !ref[i]);
+  }
+}
+
+// Set and clear every range between two edges, and count every range between
+// two edges of the result.
+template <MemoryModel MM, bitmap_word Word>
+static void ranges() {
+  constexpr mm_tag<MM> mm = {};
+  auto e = edges<Word>();
+  for (auto i : e) {
+    for (auto j : e) {
+      if (j < i) {
+        continue;
+      }
+      std::vector<Word> bits(bitmap_words<Word>(N<Word>), Word(0xa5a5a5a5));
+      std::vector<bool> ref(N<Word>);
+      for (std::size_t k = 0; k < N<Word>; ++k) {
+        ref[k] = bitmap_get(bits.data(), k, unsync);
+      }
+      bitmap_set_range(bits.data(), i, j, mm);
+      for (auto k = i; k < j; ++k) {
+        ref[k] = true;
+      }
+      check_equal(bits, ref);
+      auto c = (i + j) / 2;
+      bitmap_clear_range(bits.data(), c, j, mm);
+      for (auto k = c; k < j; ++k) {
+        ref[k] = false;
+      }
+      check_equal(bits, ref);
+      for (auto a : e) {
+        std::size_t n = 0;
+        for (auto b = a; b < j; ++b) {
+          n += ref[b];
+        }
+        ATOMIC_OPS_CHECK(bitmap_count(bits.data(), a, j, mm) == n);
+      }
+    }
+  }
+}
+
+// The reference for bitmap_first and bitmap_next: the first set bit in
+// [i, e), saturating at e.
+static std::size_t ref_first(const std::vector<bool>& ref, std::size_t i,
+                             std::size_t e) {
+  for (; i < e; ++i) {
+    if (ref[i]) {
+      return i;
+    }
+  }
+  return e;
+}
+
+// Place one or two bits at the edges, so that the searches must skip whole
+// zero blocks and then find the word inside a block, and search from every
+// edge to every end.
+template <MemoryModel MM, bitmap_word Word>
+static void scans() {
+  constexpr mm_tag<MM> mm = {};
+  auto e = edges<Word>();
+  e.pop_back();
+  for (auto x : e) {
+    for (auto y : {x, N<Word> - 1 - x % 7}) {
+      std::vector<Word> bits(bitmap_words<Word>(N<Word>));
+      std::vector<bool> ref(N<Word>);
+      bitmap_set(bits.data(), x, unsync);
+      bitmap_set(bits.data(), y, unsync);
+      ref[x] = ref[y] = true;
+      for (auto i : e) {
+        for (auto end : {i + 1, N<Word> / 2, N<Word>}) {
+          ATOMIC_OPS_CHECK(i >= end || bitmap_first(bits.data(), i, end, mm) ==
+                                           ref_first(ref, i, end));
+          ATOMIC_OPS_CHECK(bitmap_next(bits.data(), i, end, mm) ==
+                           (i + 1 < end ? ref_first(ref, i + 1, end) : end));
+        }
+      }
+    }
+  }
+
+  std::vector<Word> empty(bitmap_words<Word>(N<Word>));
+  ATOMIC_OPS_CHECK(bitmap_first(empty.data(), std::size_t(0), N<Word>, mm) ==
+                   N<Word>);
+  ATOMIC_OPS_CHECK(bitmap_any_block(empty.data(), mm) == false);
+  empty[bitmap_scan_words<Word> - 1] = 1;
+  ATOMIC_OPS_CHECK(bitmap_any_block(empty.data(), mm));
+  ATOMIC_OPS_CHECK(!bitmap_any_block(empty.data() + bitmap_scan_words<Word>,
+                                     mm));
+}
+
+// Iterate a bitmap_view over every range between two edges, for patterns of
+// different densities, and compare the indices with a bitmap_first and
+// bitmap_next loop over the same range.
+template <MemoryModel MM, bitmap_word Word>
+static void views() {
+  auto e = edges<Word>();
+  const std::size_t strides[] = {1, 3, 63, 64, 65, BLOCK_BITS<Word> + 1};
+  for (auto stride : strides) {
+    std::vector<Word> bits(bitmap_words<Word>(N<Word>));
+    for (std::size_t k = stride / 2; k < N<Word>; k += stride) {
+      bitmap_set(bits.data(), k, unsync);
+    }
+    for (auto i : e) {
+      for (auto j : e) {
+        std::vector<std::size_t> expected, found;
+        if (i < j) {
+          for (auto k = bitmap_first(bits.data(), i, j, unsync); k < j;
+               k = bitmap_next(bits.data(), k, j, unsync)) {
+            expected.push_back(k);
+          }
+        }
+        for (auto k : bitmap_view(bits.data(), i, j, mm_tag<MM>{})) {
+          found.push_back(k);
+        }
+        ATOMIC_OPS_CHECK(found == expected);
+      }
+    }
+  }
+}
+
+// Claim every range between two edges of a half-set bitmap, and check that
+// the callback reports exactly the bits that were newly set, once per word.
+// Then let the threads claim overlapping ranges at once, and check that every
+// bit is claimed by exactly one of them.
+template <MemoryModel MM, bitmap_word Word>
+static void claims() {
+  constexpr mm_tag<MM> mm = {};
+  constexpr std::size_t W = bitmap_word_bits<Word>;
+  auto e = edges<Word>();
+  for (auto i : e) {
+    for (auto j : e) {
+      std::vector<Word> bits(bitmap_words<Word>(N<Word>), Word(0x0ff00ff0));
+      auto before = bits;
+      std::vector<Word> claimed(bits.size());
+      bitmap_claim_range(bits.data(), i, j, [&](auto w, Word c) {
+        ATOMIC_OPS_CHECK(c != 0 && claimed[w] == 0);
+        claimed[w] = c;
+      }, mm);
+      for (std::size_t k = 0; k < N<Word>; ++k) {
+        bool in = i <= k && k < j;
+        bool was = bitmap_get(before.data(), k, unsync);
+        ATOMIC_OPS_CHECK(!bitmap_get(bits.data(), k, unsync) == !(was || in));
+        ATOMIC_OPS_CHECK(!bitmap_get(claimed.data(), k, unsync) ==
+                         !(in && !was));
+      }
+    }
+  }
+
+  std::vector<Word> bits(1, Word(0x5));
+  ATOMIC_OPS_CHECK(bitmap_claim_word(bits.data(), 0, Word(0x7), mm) == 0x2);
+  ATOMIC_OPS_CHECK(bitmap_claim_word(bits.data(), 0, Word(0x7), mm) == 0);
+  ATOMIC_OPS_CHECK(bits[0] == 0x7);
+
+  if constexpr (MM != Unsynchronized) {
+    using atomic_ops::test::THREADS;
+    std::vector<Word> shared(bitmap_words<Word>(N<Word>));
+    std::vector<std::vector<Word>> mine(THREADS,
+                                        std::vector<Word>(shared.size()));
+    test::run_threads(THREADS, [&](unsigned t) {
+      auto i = (t * W / 3) % N<Word>;
+      bitmap_claim_range(shared.data(), i, N<Word>, [&](auto w, Word c) {
+        mine[t][w] |= c;
+      }, mm);
+      bitmap_claim_range(shared.data(), std::size_t(0), i, [&](auto w, Word c) {
+        mine[t][w] |= c;
+      }, mm);
+    });
+    for (std::size_t w = 0; w < shared.size(); ++w) {
+      Word all = 0;
+      for (auto& m : mine) {
+        ATOMIC_OPS_CHECK((all & m[w]) == 0);
+        all |= m[w];
+      }
+      ATOMIC_OPS_CHECK(all == shared[w]);
+    }
+    ATOMIC_OPS_CHECK(bitmap_count(shared.data(), std::size_t(0), N<Word>,
+                                  unsync) == N<Word>);
+  }
+}
+
+// Apply sorted, unsorted and duplicated batches of edges to a partly set
+// bitmap, and check the bits, the count that each call returns and the masks
+// that it reports, which must be disjoint and only name bits that changed.
+template <MemoryModel MM, bitmap_word Word>
+static void batches() {
+  constexpr mm_tag<MM> mm = {};
+  auto e = edges<Word>();
+  e.pop_back();
+  auto unsorted = e;
+  for (std::size_t k = 0; k + 1 < unsorted.size(); k += 2) {
+    std::swap(unsorted[k], unsorted[k + 1]);
+  }
+  auto doubled = e;
+  doubled.insert(doubled.end(), e.begin(), e.end());
+  for (auto* idx : {&e, &unsorted, &doubled}) {
+    for (bool set : {true, false}) {
+      std::vector<Word> bits(bitmap_words<Word>(N<Word>), Word(0x0ff00ff0));
+      auto before = bits;
+      std::vector<Word> changed(bits.size());
+      auto f = [&](auto w, Word c) {
+        ATOMIC_OPS_CHECK(c != 0 && (changed[w] & c) == 0);
+        changed[w] |= c;
+      };
+      auto n = set ? bitmap_set_batch(bits.data(), idx->begin(), idx->end(),
+                                      f, mm)
+                   : bitmap_clear_batch(bits.data(), idx->begin(), idx->end(),
+                                        f, mm);
+      std::vector<bool> in(N<Word>);
+      for (auto k : e) {
+        in[k] = true;
+      }
+      std::size_t expected = 0;
+      for (std::size_t k = 0; k < N<Word>; ++k) {
+        bool was = bitmap_get(before.data(), k, unsync);
+        bool now = in[k] ? set : was;
+        expected += now != was;
+        ATOMIC_OPS_CHECK(!bitmap_get(bits.data(), k, unsync) == !now);
+        ATOMIC_OPS_CHECK(!bitmap_get(changed.data(), k, unsync) ==
+                         (now == was));
+      }
+      ATOMIC_OPS_CHECK(n == expected);
+    }
+  }
+}
+
+// Run each kernel over lengths that end in a partial vector and a partial
+// word, and check every word of the result and the count against a word at a
+// time reference. The word past the bitmap must not be written.
+template <MemoryModel MM, bitmap_word Word>
+static void combines() {
+  constexpr mm_tag<MM> mm = {};
+  constexpr std::size_t W = bitmap_word_bits<Word>;
+  constexpr std::size_t K = sizeof(typename bitmap_vector<Word>::type) /
+                            sizeof(Word);
+  constexpr Word SENTINEL = Word(0x5a5a5a5a5a5a5a5a);
+  for (std::size_t n : {std::size_t(1), W - 1, W, W + 1, K * W - 1, K * W,
+                        K * W + 1, (K + 1) * W, 3 * K * W + 37}) {
+    auto words = bitmap_words<Word>(n);
+    std::vector<Word> a(words + 1), b(words + 1);
+    unsigned long x = n;
+    for (std::size_t w = 0; w < words; ++w) {
+      a[w] = Word(x = x * 6364136223846793005ul + 1442695040888963407ul);
+      b[w] = Word(x = x * 6364136223846793005ul + 1442695040888963407ul) ^
+             ((w % 3 == 0) ? ~Word(0) : Word(0));
+    }
+    a[words - 1] &= bitmap_mask(Word(0), Word((n - 1) % W + 1));
+    b[words - 1] &= bitmap_mask(Word(0), Word((n - 1) % W + 1));
+
+    auto check = [&](auto&& op, auto&& kernel, auto&& into) {
+      std::vector<Word> expected(words);
+      std::size_t count = 0;
+      for (std::size_t w = 0; w < words; ++w) {
+        expected[w] = Word(op(a[w], b[w]));
+        count += std::popcount(expected[w]);
+      }
+      std::vector<Word> dst(words + 1, SENTINEL);
+      ATOMIC_OPS_CHECK(kernel(dst.data(), a.data(), b.data(), n, mm) == count);
+      ATOMIC_OPS_CHECK(dst[words] == SENTINEL);
+      dst.pop_back();
+      ATOMIC_OPS_CHECK(dst == expected);
+      dst = a;
+      dst.back() = SENTINEL;
+      ATOMIC_OPS_CHECK(into(dst.data(), b.data(), n, mm) == count);
+      ATOMIC_OPS_CHECK(dst[words] == SENTINEL);
+      dst.pop_back();
+      ATOMIC_OPS_CHECK(dst == expected);
+    };
+    check([](auto x, auto y) { return x & y; },
+          [](auto... args) { return bitmap_and(args...); },
+          [](auto... args) { return bitmap_and_into(args...); });
+    check([](auto x, auto y) { return x | y; },
+          [](auto... args) { return bitmap_or(args...); },
+          [](auto... args) { return bitmap_or_into(args...); });
+    check([](auto x, auto y) { return x ^ y; },
+          [](auto... args) { return bitmap_xor(args...); },
+          [](auto... args) { return bitmap_xor_into(args...); });
+    check([](auto x, auto y) { return x & ~y; },
+          [](auto... args) { return bitmap_andnot(args...); },
+          [](auto... args) { return bitmap_andnot_into(args...); });
+  }
+}
+
+template <MemoryModel MM, bitmap_word Word>
+static void all() {
+  ranges<MM, Word>();
+  scans<MM, Word>();
+  claims<MM, Word>();
+  batches<MM, Word>();
+  combines<MM, Word>();
+  views<MM, Word>();
+}
+
+template <bitmap_word Word>
+static void all_models() {
+  all<SequentialConsistency, Word>();
+  all<ReleaseConsistency, Word>();
+  all<RelaxedConsistency, Word>();
+  all<Unsynchronized, Word>();
+}
+
+int main() {
+  all_models<unsigned long>();
+  all_models<std::uint32_t>();
+  all_models<std::uint64_t>();
+}
@@ -0,0 +1,106 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include <atomic_ops/bitmap_parallel.hpp>
+#include <atomic_ops/numa_bitmap.hpp>
+#include <cstddef>
+#include <vector>
+#include "test.hpp"
+
+using namespace atomic_ops;
+using atomic_ops::test::THREADS;
+
+static constexpr std::size_t CHUNKS = 1000;
+static constexpr int CALLS = 200;
+
+// Call `run(n, f)` repeatedly on a pool, and check that every chunk runs
+// exactly once per call, and that a call made from inside a chunk runs inline
+// rather than deadlocking on the busy workers.
+template <typename Run>
+static void chunks(Run&& run) {
+  std::vector<unsigned long> hits(CHUNKS);
+  for (int c = 1; c <= CALLS; ++c) {
+    std::size_t n = (c % 2) ? CHUNKS : c;
+    hits.assign(CHUNKS, 0);
+    run(n, [&](std::size_t i) {
+      fetch_add(hits[i], 1ul, rc);
+    });
+    for (std::size_t i = 0; i < CHUNKS; ++i) {
+      ATOMIC_OPS_CHECK(hits[i] == (i < n));
+    }
+  }
+
+  unsigned long nested = 0;
+  run(8, [&](std::size_t) {
+    run(8, [&](std::size_t) { fetch_add(nested, 1ul, rc); });
+  });
+  ATOMIC_OPS_CHECK(nested == 64);
+  run(0, [](std::size_t) { ATOMIC_OPS_CHECK(false); });
+}
+
+// The parallel bitmap operations agree with a serial count and visit every set
+// bit once on each pool.
+template <typename Executor>
+static void bitmaps(Executor&& ex) {
+  constexpr std::size_t N = 5 * BITMAP_CHUNK_WORDS * BITMAP_WORD_BITS + 77;
+  std::vector<unsigned long> bits(bitmap_words(N));
+  for (std::size_t i = 0; i < N; i += 7) {
+    bitmap_set(bits.data(), i, unsync);
+  }
+  std::size_t n = bitmap_count(bits.data(), std::size_t(0), N, unsync);
+  ATOMIC_OPS_CHECK(bitmap_count_parallel(bits.data(), N, rc, ex) == n);
+  std::vector<unsigned long> seen(N);
+  bitmap_for_each_parallel(bits.data(), N, [&](std::size_t i) {
+    ATOMIC_OPS_CHECK(exchange(seen[i], 1ul, rc) == 0);
+  }, rc, ex);
+  for (std::size_t i = 0; i < N; ++i) {
+    ATOMIC_OPS_CHECK(seen[i] == (i % 7 == 0));
+  }
+}
+
+int main() {
+  thread_pool pool(THREADS);
+  chunks([&](std::size_t n, auto&& f) { pool(n, f); });
+  bitmaps(pool);
+  thread_pool alone(1);
+  chunks([&](std::size_t n, auto&& f) { alone(n, f); });
+
+  // Two slots for node 0, so that the pool has a worker even with one CPU. The
+  // chunks owned by node 1, which is not in the pool, go to the second slot,
+  // which is the worker's home, and the rest to the caller's.
+  numa_pool numa({0, 0});
+  chunks([&](std::size_t n, auto&& f) {
+    numa(n, [](std::size_t i) { return int(i % 2); }, f);
+  });
+  numa_bitmap<> nb(5 * BITMAP_CHUNK_WORDS * BITMAP_WORD_BITS);
+  bitmap_set(nb.data(), std::size_t(12345), rc);
+  ATOMIC_OPS_CHECK(bitmap_count_parallel(nb.data(), nb.size(), rc,
+                                         nb.executor(numa)) == 1);
+}
@@ -0,0 +1,149 @@
+# BSD 3-Clause License
+#
+# Copyright (c) 2020, Trustees of Indiana University
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice, this
+#    list of conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+#    this list of conditions and the following disclaimer in the documentation
+#    and/or other materials provided with the distribution.
+#
+# 3. Neither the name of the copyright holder nor the names of its
+#    contributors may be used to endorse or promote products derived from
+#    this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+# DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+# SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+# CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+# OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+# Compile codegen.cpp to assembly and check the instructions of each tagged
+# primitive against the minimal forms that its model should lower to.
+#
+# Run with cmake -P and COMPILER, SOURCE, INCLUDE, OUTPUT and ARCH defined,
+# and FLAGS, such as --target for clang, to compile for another architecture.
+
+execute_process(
+  COMMAND ${COMPILER} ${FLAGS} -std=c++20 -O2 -S -I${INCLUDE} -o ${OUTPUT}
+          ${SOURCE}
+  RESULT_VARIABLE result
+  ERROR_VARIABLE error)
+if (NOT result EQUAL 0)
+  message(FATAL_ERROR "compiling ${SOURCE} failed:\n${error}")
+endif ()
+file(READ ${OUTPUT} assembly)
+
+# Check that the body of `codegen_<fn>` matches the regex REQUIRE, if given,
+# and does not match the regex FORBID, if given. The function's name and the
+# comments, in which clang repeats the name, are stripped first.
+function(expect fn)
+  cmake_parse_arguments(ARG "" "REQUIRE;FORBID" "" ${ARGN})
+  string(FIND "${assembly}" "codegen_${fn}:" begin)
+  if (begin EQUAL -1)
+    message(SEND_ERROR "codegen_${fn}: not found in ${OUTPUT}")
+    return()
+  endif ()
+  string(SUBSTRING "${assembly}" ${begin} -1 body)
+  string(FIND "${body}" ".cfi_endproc" end)
+  string(SUBSTRING "${body}" 0 ${end} body)
+  string(REPLACE "codegen_${fn}" "" body "${body}")
+  string(REGEX REPLACE "(#|//)[^\n]*" "" body "${body}")
+  if (ARG_REQUIRE AND NOT body MATCHES "${ARG_REQUIRE}")
+    message(SEND_ERROR "codegen_${fn}: expected /${ARG_REQUIRE}/ in${body}")
+  endif ()
+  if (ARG_FORBID AND body MATCHES "${ARG_FORBID}")
+    message(SEND_ERROR "codegen_${fn}: unexpected /${ARG_FORBID}/ in${body}")
+  endif ()
+endfunction()
+
+if (ARCH MATCHES "^(x86_64|AMD64|amd64)$")
+  # Loads are plain movs in every model, and so are stores other than sc,
+  # which needs an xchg or a fence. The atomic models' RMWs are locked, and
+  # an sc fence is an mfence or a locked no-op. Nothing else is fenced, and
+  # nothing unsync is locked.
+  set(barrier "lock|xchg|mfence")
+  foreach (mm sc rc xc unsync)
+    expect(load_${mm} FORBID "${barrier}")
+  endforeach ()
+  expect(store_sc REQUIRE "xchg|mfence")
+  foreach (mm sc rc xc)
+    expect(exchange_${mm} REQUIRE "xchg")
+    expect(fetch_add_${mm} REQUIRE "lock")
+    expect(cas_${mm} REQUIRE "lock[ \t]+cmpxchg")
+    expect(bitmap_set_${mm} REQUIRE "lock")
+  endforeach ()
+  foreach (mm rc xc unsync)
+    expect(store_${mm} FORBID "${barrier}")
+  endforeach ()
+  expect(fence_sc REQUIRE "mfence|lock")
+  foreach (mm rc xc unsync)
+    expect(fence_${mm} FORBID "${barrier}")
+  endforeach ()
+  foreach (fn exchange fetch_add cas bitmap_set)
+    expect(${fn}_unsync FORBID "${barrier}|cmpxchg")
+  endforeach ()
+elseif (ARCH MATCHES "^(aarch64|arm64|ARM64)$")
+  # sc and rc loads are load-acquires and their stores store-releases, and
+  # their RMWs are acquire-release, as LSE instructions, exclusive pairs, or
+  # outline helpers. xc uses the relaxed forms, and unsync no atomics at all.
+  set(lse "(swp|ldadd|cas|ldset)")
+  set(ordered_rmw "${lse}al[ \t]|ldaxr|__aarch64_[a-z]+[0-9]+_acq_rel")
+  set(relaxed_rmw "${lse}[ \t]|ldxr|__aarch64_[a-z]+[0-9]+_relax")
+  set(any_rmw "${lse}|ldxr|ldaxr|stxr|stlxr|__aarch64_")
+  expect(load_sc REQUIRE "ldar")
+  expect(load_rc REQUIRE "ldar|ldapr")
+  foreach (mm sc rc)
+    expect(store_${mm} REQUIRE "stlr")
+    expect(fence_${mm} REQUIRE "dmb")
+    foreach (fn exchange fetch_add cas bitmap_set)
+      expect(${fn}_${mm} REQUIRE "${ordered_rmw}")
+    endforeach ()
+  endforeach ()
+  foreach (mm xc unsync)
+    expect(load_${mm} FORBID "ldar|ldapr|dmb")
+    expect(store_${mm} FORBID "stlr|dmb")
+    expect(fence_${mm} FORBID "dmb")
+  endforeach ()
+  foreach (fn exchange fetch_add cas bitmap_set)
+    expect(${fn}_xc REQUIRE "${relaxed_rmw}"
+           FORBID "dmb|${ordered_rmw}|${lse}(a|l)[ \t]|stlxr")
+    expect(${fn}_unsync FORBID "dmb|${any_rmw}")
+  endforeach ()
+elseif (ARCH MATCHES "^(ppc64le|powerpc64le|ppc64)$")
+  # sc puts a heavyweight sync before each access, and its loads and RMWs
+  # end in isync. rc uses lwsync before stores and RMWs, and its loads end
+  # in isync. xc and unsync have no barriers at all, and unsync no reserved
+  # loads or conditional stores.
+  set(hwsync "[ \t](hw)?sync[ \t\n]")
+  set(barrier "sync|isync")
+  set(reserved "l[bhwd]arx|st[bhwd]cx")
+  foreach (fn load store exchange fetch_add cas bitmap_set fence)
+    expect(${fn}_sc REQUIRE "${hwsync}")
+  endforeach ()
+  expect(load_rc REQUIRE "isync|lwsync" FORBID "${hwsync}")
+  foreach (fn store exchange fetch_add cas bitmap_set fence)
+    expect(${fn}_rc REQUIRE "lwsync" FORBID "${hwsync}")
+  endforeach ()
+  foreach (fn exchange fetch_add cas bitmap_set)
+    expect(${fn}_xc REQUIRE "${reserved}" FORBID "${barrier}")
+    expect(${fn}_unsync FORBID "${barrier}|${reserved}")
+  endforeach ()
+  foreach (mm xc unsync)
+    foreach (fn load store fence)
+      expect(${fn}_${mm} FORBID "${barrier}")
+    endforeach ()
+  endforeach ()
+else ()
+  message(FATAL_ERROR "no codegen expectations for ${ARCH}")
+endif ()
@@ -0,0 +1,70 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include <atomic_ops/atomic_ops.hpp>
+#include <atomic_ops/bitmap_ops.hpp>
+#include <cstddef>
+
+// Each tagged primitive for each model, in a function with a fixed name, so
+// that check_codegen.cmake can find its instructions in the assembly that
+// this file is compiled to. This file is only compiled with -S, never linked.
+using namespace atomic_ops;
+
+#define ATOMIC_OPS_CODEGEN(name, tag)                                     \
+  extern "C" unsigned long codegen_load_##name(unsigned long* t) {        \
+    return load(*t, tag);                                                 \
+  }                                                                       \
+  extern "C" void codegen_store_##name(unsigned long* t, unsigned long u) { \
+    store(*t, u, tag);                                                    \
+  }                                                                       \
+  extern "C" unsigned long codegen_exchange_##name(unsigned long* t,      \
+                                                   unsigned long u) {     \
+    return exchange(*t, u, tag);                                          \
+  }                                                                       \
+  extern "C" unsigned long codegen_fetch_add_##name(unsigned long* t,     \
+                                                    unsigned long u) {    \
+    return fetch_add(*t, u, tag);                                         \
+  }                                                                       \
+  extern "C" bool codegen_cas_##name(unsigned long* t, unsigned long* e,  \
+                                     unsigned long d) {                   \
+    return compare_exchange_strong(*t, *e, d, tag);                       \
+  }                                                                       \
+  extern "C" void codegen_fence_##name() {                                \
+    thread_fence(tag);                                                    \
+  }                                                                       \
+  extern "C" unsigned long codegen_bitmap_set_##name(unsigned long* b,    \
+                                                     std::size_t i) {     \
+    return bitmap_set(b, i, tag);                                         \
+  }
+
+ATOMIC_OPS_CODEGEN(sc, sc)
+ATOMIC_OPS_CODEGEN(rc, rc)
+ATOMIC_OPS_CODEGEN(xc, xc)
+ATOMIC_OPS_CODEGEN(unsync, unsync)
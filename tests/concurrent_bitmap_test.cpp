@@ -0,0 +1,107 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include <atomic_ops/concurrent_bitmap.hpp>
+#include <cstddef>
+#include <stdexcept>
+#include "test.hpp"
+
+using namespace atomic_ops;
+using atomic_ops::test::THREADS;
+
+template <MemoryModel MM>
+static void sequential() {
+  concurrent_bitmap<MM> b(0, 1);
+  ATOMIC_OPS_CHECK(b.capacity() == 0);
+  ATOMIC_OPS_CHECK(b.first(0, 1000) == 1000);
+
+  std::size_t bits[] = {0, 1, 63, 64, 65, 127, 128, 1000, 4095, 4096, 100000};
+  for (auto i : bits) {
+    ATOMIC_OPS_CHECK(!b.set(i));
+    ATOMIC_OPS_CHECK(b.set(i));
+    ATOMIC_OPS_CHECK(b.get(i));
+  }
+  b.reserve(200000);
+  ATOMIC_OPS_CHECK(b.capacity() >= 200000);
+
+  std::size_t k = 0;
+  for (auto i = b.first(0, 200000); i < 200000; i = b.next(i, 200000)) {
+    ATOMIC_OPS_CHECK(i == bits[k++]);
+  }
+  ATOMIC_OPS_CHECK(k == std::size(bits));
+
+  ATOMIC_OPS_CHECK(b.clear(64));
+  ATOMIC_OPS_CHECK(!b.clear(64));
+  ATOMIC_OPS_CHECK(!b.get(64));
+  ATOMIC_OPS_CHECK(b.get(63) && b.get(65));
+  ATOMIC_OPS_CHECK(b.next(63, 200000) == 65);
+  ATOMIC_OPS_CHECK(b.first(1001, 4095) == 4095);
+  ATOMIC_OPS_CHECK(!b.get(std::size_t(1) << 60));
+  ATOMIC_OPS_CHECK(!b.clear(std::size_t(1) << 60));
+
+  bool threw = false;
+  try {
+    b.set(~std::size_t(0));
+  }
+  catch (const std::length_error&) {
+    threw = true;
+  }
+  ATOMIC_OPS_CHECK(threw);
+}
+
+// Every thread sets a disjoint stride of bits, which races on the words and on
+// the allocation of the segments, and then clears every other one of its bits.
+static void concurrent() {
+  constexpr std::size_t N = 1 << 18;
+  concurrent_bitmap<> b(0, 1);
+  test::run_threads(THREADS, [&](unsigned t) {
+    for (std::size_t i = t; i < N; i += THREADS) {
+      ATOMIC_OPS_CHECK(!b.set(i));
+    }
+    for (std::size_t i = t; i < N; i += 2 * THREADS) {
+      ATOMIC_OPS_CHECK(b.clear(i));
+    }
+  });
+
+  std::size_t n = 0;
+  for (auto i = b.first(0, N); i < N; i = b.next(i, N)) {
+    ATOMIC_OPS_CHECK(i % (2 * THREADS) >= THREADS);
+    ++n;
+  }
+  ATOMIC_OPS_CHECK(n == N / 2);
+}
+
+int main() {
+  sequential<SequentialConsistency>();
+  sequential<ReleaseConsistency>();
+  sequential<RelaxedConsistency>();
+  sequential<Unsynchronized>();
+  concurrent();
+}
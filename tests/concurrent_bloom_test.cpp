@@ -0,0 +1,151 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include <atomic_ops/concurrent_bloom.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "test.hpp"
+
+using namespace atomic_ops;
+using atomic_ops::test::THREADS;
+
+static constexpr std::size_t KEYS = 1 << 14;
+static constexpr std::size_t BITS = 10 * KEYS;
+
+// The hash of key `k` of thread `t`, which the filters mix again.
+static std::uint64_t key(unsigned t, std::size_t k) {
+  return (std::uint64_t(t) << 32) + k;
+}
+
+// Inserting a key reports whether it set any bits, a second insert of it does
+// not, and it is found afterwards. The false positive rate at 10 bits per key
+// stays well below 3%.
+template <MemoryModel MM, int K>
+static void sequential() {
+  concurrent_bloom<MM, K> bloom(BITS);
+  ATOMIC_OPS_CHECK(bloom.size() >= BITS);
+  std::size_t fresh = 0;
+  for (std::size_t k = 0; k < KEYS; ++k) {
+    fresh += bloom.insert(key(0, k));
+    ATOMIC_OPS_CHECK(!bloom.insert(key(0, k)));
+    ATOMIC_OPS_CHECK(bloom.contains(key(0, k)));
+  }
+  ATOMIC_OPS_CHECK(fresh > KEYS - KEYS / 20);
+
+  std::size_t positives = 0;
+  for (std::size_t k = 0; k < KEYS; ++k) {
+    positives += bloom.contains(key(1, k));
+  }
+  ATOMIC_OPS_CHECK(positives < 3 * KEYS / 100);
+
+  std::vector<std::uint64_t> h(KEYS);
+  std::vector<unsigned char> out(KEYS);
+  for (std::size_t k = 0; k < KEYS; ++k) {
+    h[k] = key(0, k);
+  }
+  ATOMIC_OPS_CHECK(bloom.contains_batch(h.begin(), h.end(), out.begin()) ==
+                   KEYS);
+  for (auto o : out) {
+    ATOMIC_OPS_CHECK(o);
+  }
+  ATOMIC_OPS_CHECK(bloom.insert_batch(h.begin(), h.end()) == 0);
+}
+
+// Half of the threads insert their own keys into a shared filter, and publish
+// how many they have inserted. The other half query the keys that a writer
+// has published, which share words with the keys that are being inserted, so
+// a lost fetch_or or a stale read shows up as a false negative.
+template <MemoryModel MM>
+static void concurrent() {
+  concurrent_bloom<MM> bloom(BITS);
+  constexpr unsigned WRITERS = THREADS / 2;
+  constexpr std::size_t PER = KEYS / WRITERS;
+  std::vector<std::size_t> published(WRITERS);
+  test::run_threads(THREADS, [&](unsigned t) {
+    if (t < WRITERS) {
+      for (std::size_t k = 0; k < PER; ++k) {
+        bloom.insert(key(t, k));
+        ATOMIC_OPS_CHECK(bloom.contains(key(t, k)));
+        store(published[t], k + 1, rc);
+      }
+      return;
+    }
+    unsigned w = t - WRITERS;
+    for (std::size_t n = 0; n < PER;) {
+      n = load(published[w], rc);
+      for (std::size_t k = (n > 64) ? n - 64 : 0; k < n; ++k) {
+        ATOMIC_OPS_CHECK(bloom.contains(key(w, k)));
+      }
+    }
+  });
+  for (unsigned t = 0; t < WRITERS; ++t) {
+    for (std::size_t k = 0; k < PER; ++k) {
+      ATOMIC_OPS_CHECK(bloom.contains(key(t, k)));
+    }
+  }
+}
+
+// The threads insert their keys twice and then remove every other key once,
+// concurrently with each other, so that the counters of different keys race.
+// Every key must still be present, with a count of at least the inserts
+// that are left, unless a counter has saturated.
+template <MemoryModel MM, int Bits>
+static void counting() {
+  concurrent_counting_bloom<MM, 8, Bits> bloom(BITS);
+  constexpr std::size_t PER = KEYS / THREADS;
+  test::run_threads(THREADS, [&](unsigned t) {
+    for (std::size_t k = 0; k < PER; ++k) {
+      bloom.insert(key(t, k));
+      bloom.insert(key(t, k));
+      ATOMIC_OPS_CHECK(bloom.count(key(t, k)) >= 2);
+    }
+    for (std::size_t k = 0; k < PER; k += 2) {
+      bloom.remove(key(t, k));
+    }
+  });
+  for (unsigned t = 0; t < THREADS; ++t) {
+    for (std::size_t k = 0; k < PER; ++k) {
+      ATOMIC_OPS_CHECK(bloom.count(key(t, k)) >= ((k % 2) ? 2 : 1));
+    }
+  }
+}
+
+int main() {
+  sequential<SequentialConsistency, 8>();
+  sequential<ReleaseConsistency, 8>();
+  sequential<RelaxedConsistency, 6>();
+  sequential<Unsynchronized, 8>();
+  concurrent<SequentialConsistency>();
+  concurrent<ReleaseConsistency>();
+  counting<ReleaseConsistency, 4>();
+  counting<ReleaseConsistency, 8>();
+  counting<SequentialConsistency, 16>();
+}
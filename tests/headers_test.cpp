@@ -0,0 +1,270 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include <atomic_ops/atomic.hpp>
+#include <atomic_ops/atomic_ops.hpp>
+#include <atomic_ops/bitmap_alloc.hpp>
+#include <atomic_ops/bitmap_ops.hpp>
+#include <atomic_ops/bitmap_parallel.hpp>
+#include <atomic_ops/bitmap_view.hpp>
+#include <atomic_ops/bitmap_write_combiner.hpp>
+#include <atomic_ops/concurrent_bitmap.hpp>
+#include <atomic_ops/concurrent_bloom.hpp>
+#include <atomic_ops/hierarchical_bitmap.hpp>
+#include <atomic_ops/lock.hpp>
+#include <atomic_ops/mapped_bitmap.hpp>
+#include <atomic_ops/mpmc_queue.hpp>
+#include <atomic_ops/numa_bitmap.hpp>
+#include <atomic_ops/packed_array.hpp>
+#include <atomic_ops/phase.hpp>
+#include <atomic_ops/reclaim.hpp>
+#include <atomic_ops/sharded_counter.hpp>
+#include <atomic_ops/static_bitmap.hpp>
+#include <atomic_ops/versioned_bitmap.hpp>
+#include <atomic_ops/wait.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "test.hpp"
+
+// Every public header is included above, and every class template is
+// explicitly instantiated below for each memory model that it accepts, so a
+// member that does not compile for some model fails this build rather than a
+// user's. The function templates and member templates are called from ops().
+// The test is also built with ATOMIC_OPS_INSTRUMENT, which covers
+// instrument.hpp and the instrumented signatures, and with ATOMIC_OPS_EXECUTION
+// when TBB is available.
+namespace atomic_ops {
+#define ATOMIC_OPS_INSTANTIATE_ANY(MM)                        \
+  template class ref<unsigned long, MM>;                      \
+  template class ref<std::uint32_t, MM>;                      \
+  template class atomic<unsigned long, MM>;                   \
+  template class atomic<std::uint8_t, MM>;                    \
+  template class bitmap_allocator<MM>;                        \
+  template class bitmap_view<MM>;                             \
+  template class bitmap_view<MM, unsigned>;                   \
+  template class bitmap_write_combiner<MM>;                   \
+  template class concurrent_bitmap<MM>;                       \
+  template class concurrent_bloom<MM>;                        \
+  template class concurrent_bloom<MM, 6>;                     \
+  template class concurrent_counting_bloom<MM>;               \
+  template class concurrent_counting_bloom<MM, 4, 8>;         \
+  template class hierarchical_bitmap<MM>;                     \
+  template class mapped_bitmap<MM>;                           \
+  template class numa_bitmap<MM>;                             \
+  template class packed_array<4, unsigned long, MM>;          \
+  template class packed_array<8, std::uint32_t, MM>;          \
+  template class sharded_counter<MM>;                         \
+  template class sharded_counter<MM, 8, std::uint32_t>;       \
+  template class static_bitmap<1000, MM>;
+
+// The models that hand off data, which mpmc_queue and versioned_bitmap need.
+#define ATOMIC_OPS_INSTANTIATE_ORDERED(MM)                    \
+  template class mpmc_queue<unsigned long, MM>;               \
+  template class mpmc_queue<unsigned long, MM, true>;         \
+  template class versioned_bitmap<MM>;                        \
+  template class versioned_bitmap<MM, 1>;
+
+ATOMIC_OPS_INSTANTIATE_ANY(SequentialConsistency)
+ATOMIC_OPS_INSTANTIATE_ANY(ReleaseConsistency)
+ATOMIC_OPS_INSTANTIATE_ANY(RelaxedConsistency)
+ATOMIC_OPS_INSTANTIATE_ANY(Unsynchronized)
+ATOMIC_OPS_INSTANTIATE_ORDERED(SequentialConsistency)
+ATOMIC_OPS_INSTANTIATE_ORDERED(ReleaseConsistency)
+template class mpmc_queue<unsigned long, Unsynchronized>;
+template class striped_lock<spinlock>;
+template class striped_lock<ticket_lock>;
+template class striped_lock<rw_spinlock>;
+}
+
+using namespace atomic_ops;
+
+template <typename T, MemoryModel MM>
+static void scalar() {
+  constexpr mm_tag<MM> mm = {};
+  T t = 0;
+  T e = 0;
+  store(t, T(1), mm);
+  ATOMIC_OPS_CHECK(load(t, mm) == 1);
+  ATOMIC_OPS_CHECK(exchange(t, T(2), mm) == 1);
+  ATOMIC_OPS_CHECK(!compare_exchange_strong(t, e, T(3), mm) && e == 2);
+  ATOMIC_OPS_CHECK(compare_exchange_weak(t, e, T(3), mm) || e == 2);
+  store(t, T(3), mm);
+  fetch_add(t, T(4), mm);
+  fetch_sub(t, T(1), mm);
+  fetch_and(t, T(6), mm);
+  fetch_or(t, T(8), mm);
+  fetch_xor(t, T(1), mm);
+  fetch_nand(t, T(~0), mm);
+  fetch_min(t, T(5), mm);
+  fetch_max(t, T(9), mm);
+  ATOMIC_OPS_CHECK(load(t, mm) == 9);
+
+  ref<T, MM> r(t);
+  r.store(1);
+  r.exchange(2);
+  r.compare_exchange_strong(e, 3);
+  r.compare_exchange_weak(e, 3);
+  r.fetch_add(1);
+  r.fetch_sub(1);
+  r.fetch_and(7);
+  r.fetch_or(8);
+  r.fetch_xor(1);
+  r.fetch_nand(0);
+  r.fetch_min(5);
+  r.fetch_max(9);
+  ATOMIC_OPS_CHECK(r.load() == 9);
+
+  atomic<T, MM> a(T(1));
+  a.store(2);
+  a.fetch_add(1);
+  a.fetch_max(7);
+  ATOMIC_OPS_CHECK(a.load() == 7);
+}
+
+// An 8 byte aligned pair would fault in the 16 byte operations.
+struct alignas(16) pair {
+  std::uint64_t lo, hi;
+};
+
+template <MemoryModel MM>
+static void wide() {
+#if !defined(__x86_64__) || defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+  constexpr mm_tag<MM> mm = {};
+  pair p = {1, 2};
+  pair e = {1, 2};
+  store(p, pair{3, 4}, mm);
+  ATOMIC_OPS_CHECK(load(p, mm).hi == 4);
+  ATOMIC_OPS_CHECK(exchange(p, pair{5, 6}, mm).lo == 3);
+  ATOMIC_OPS_CHECK(!compare_exchange_strong(p, e, pair{7, 8}, mm));
+  ATOMIC_OPS_CHECK(compare_exchange_strong(p, e, pair{7, 8}, mm));
+  ATOMIC_OPS_CHECK(load(p, mm).lo == 7);
+#endif
+}
+
+template <MemoryModel MM>
+static void ops() {
+  constexpr mm_tag<MM> mm = {};
+  wide<MM>();
+  scalar<unsigned long, MM>();
+  scalar<std::uint32_t, MM>();
+  scalar<std::uint16_t, MM>();
+  scalar<std::uint8_t, MM>();
+  thread_fence(mm);
+
+  constexpr std::size_t N = 4096;
+  std::vector<unsigned long> a(bitmap_words(N)), b(a.size()), c(a.size());
+  std::vector<std::uint32_t> s(bitmap_words<std::uint32_t>(N));
+  bitmap_set(a.data(), std::size_t(3), mm);
+  bitmap_set(s.data(), std::size_t(5), mm);
+  ATOMIC_OPS_CHECK(bitmap_get(a.data(), std::size_t(3), mm));
+  ATOMIC_OPS_CHECK(bitmap_clear(s.data(), std::size_t(5), mm));
+  bitmap_set_range(a.data(), std::size_t(100), std::size_t(300), mm);
+  bitmap_clear_range(a.data(), std::size_t(200), std::size_t(250), mm);
+  ATOMIC_OPS_CHECK(bitmap_count(a.data(), std::size_t(0), N, mm) == 151);
+  ATOMIC_OPS_CHECK(bitmap_first(a.data(), std::size_t(4), N, mm) == 100);
+  ATOMIC_OPS_CHECK(bitmap_next(a.data(), std::size_t(3), N, mm) == 100);
+  ATOMIC_OPS_CHECK(bitmap_any_block(a.data(), mm));
+  std::size_t idx[] = {1, 2, 4000};
+  bitmap_set_batch(b.data(), idx, idx + 3, mm);
+  bitmap_clear_batch(b.data(), idx, idx + 1, mm);
+  bitmap_and(c.data(), a.data(), b.data(), N, mm);
+  bitmap_or(c.data(), a.data(), b.data(), N, mm);
+  bitmap_xor(c.data(), a.data(), b.data(), N, mm);
+  bitmap_andnot(c.data(), a.data(), b.data(), N, mm);
+  bitmap_and_into(c.data(), a.data(), N, mm);
+  bitmap_or_into(c.data(), a.data(), N, mm);
+  bitmap_xor_into(c.data(), a.data(), N, mm);
+  bitmap_andnot_into(c.data(), a.data(), N, mm);
+  ATOMIC_OPS_CHECK(bitmap_count(c.data(), std::size_t(0), N, mm) == 0);
+
+  std::size_t k = 0;
+  for (auto i : bitmap_view(a.data(), std::size_t(0), N, mm)) {
+    k += bitmap_get(a.data(), i, mm) != 0;
+  }
+  ATOMIC_OPS_CHECK(k == 151);
+  ATOMIC_OPS_CHECK(bitmap_count_parallel(a.data(), N, mm) == 151);
+  bitmap_for_each_parallel(
+      a.data(), N, [&](std::size_t i) { fetch_add(k, i, rc); }, mm);
+  std::vector<std::uint32_t> a32(bitmap_words<std::uint32_t>(N));
+  std::size_t k32 = 0;
+  for (auto i : bitmap_view(a.data(), std::size_t(0), N, mm)) {
+    bitmap_set(a32.data(), i, mm);
+    k32 += i;
+  }
+  ATOMIC_OPS_CHECK(bitmap_count_parallel(a32.data(), N, mm) == 151);
+  bitmap_for_each_parallel(
+      a32.data(), N, [&](std::size_t i) { fetch_sub(k32, i, rc); }, mm);
+  ATOMIC_OPS_CHECK(k32 == 0);
+  numa_bitmap<MM> nb(N);
+  bitmap_set(nb.data(), std::size_t(7), mm);
+  numa_executor<numa_bitmap<MM>> on_nodes{numa_pool::global(), nb};
+  ATOMIC_OPS_CHECK(bitmap_count_parallel(nb.data(), N, mm, on_nodes) == 1);
+  ATOMIC_OPS_CHECK(bitmap_count_parallel(a.data(), N, mm,
+                                         serial_executor()) == 151);
+#if defined(ATOMIC_OPS_EXECUTION)
+  policy_executor in_parallel{std::execution::par};
+  ATOMIC_OPS_CHECK(bitmap_count_parallel(a.data(), N, mm, in_parallel) == 151);
+#endif
+
+  std::size_t i = bitmap_alloc(b.data(), N, mm);
+  bitmap_free(b.data(), i, mm);
+  i = bitmap_alloc(b.data(), N, std::size_t(70), mm);
+  bitmap_free(b.data(), i, std::size_t(70), mm);
+
+  std::uint64_t h[] = {1, 2, 3};
+  bool out[3];
+  concurrent_bloom<MM> bloom(1 << 12);
+  bloom.insert_batch(h, h + 3);
+  ATOMIC_OPS_CHECK(bloom.contains_batch(h, h + 3, out) == 3);
+  concurrent_counting_bloom<MM> counting(1 << 12);
+  counting.insert_batch(h, h + 3);
+  ATOMIC_OPS_CHECK(counting.contains_batch(h, h + 3, out) == 3);
+
+  sharded_counter<MM> counter;
+  counter.add(1);
+  counter.add(2, 5);
+  ATOMIC_OPS_CHECK(counter.load() == 3);
+
+  phase_barrier barrier(1);
+  with_phase<MM>(barrier, [](auto) {});
+}
+
+int main() {
+  ops<SequentialConsistency>();
+  ops<ReleaseConsistency>();
+  ops<RelaxedConsistency>();
+  ops<Unsynchronized>();
+
+  unsigned long w = 1;
+  wait(w, 0ul, rc);
+  notify_one(w);
+  notify_all(w);
+}
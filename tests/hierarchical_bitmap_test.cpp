@@ -0,0 +1,149 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include <atomic_ops/hierarchical_bitmap.hpp>
+#include <cstddef>
+#include <vector>
+#include "test.hpp"
+
+using namespace atomic_ops;
+using atomic_ops::test::THREADS;
+
+template <MemoryModel MM>
+static void sequential() {
+  constexpr std::size_t N = 300000;
+  hierarchical_bitmap<MM> b(N);
+  ATOMIC_OPS_CHECK(b.size() == N);
+  ATOMIC_OPS_CHECK(b.first(0, N) == N);
+  ATOMIC_OPS_CHECK(b.first(0, 2 * N) == 2 * N);
+
+  std::size_t bits[] = {0, 63, 64, 4095, 4096, 262143, 262144, N - 1};
+  for (auto i : bits) {
+    ATOMIC_OPS_CHECK(!b.set(i));
+    ATOMIC_OPS_CHECK(b.set(i));
+  }
+  std::size_t k = 0;
+  for (auto i = b.first(0, N); i < N; i = b.next(i, N)) {
+    ATOMIC_OPS_CHECK(i == bits[k++]);
+  }
+  ATOMIC_OPS_CHECK(k == std::size(bits));
+  ATOMIC_OPS_CHECK(b.first(65, 4095) == 4095);
+  ATOMIC_OPS_CHECK(b.next(N - 1, 2 * N) == 2 * N);
+
+  for (auto i : bits) {
+    ATOMIC_OPS_CHECK(b.clear(i));
+    ATOMIC_OPS_CHECK(!b.clear(i));
+  }
+  ATOMIC_OPS_CHECK(b.first(0, N) == N);
+}
+
+// Writers set and clear bits that share words with a fixed set of pinned bits,
+// so clear() keeps racing set() on the same summary bits, while a reader checks
+// that every pinned bit stays reachable through the summaries.
+template <MemoryModel MM>
+static void racing() {
+  constexpr std::size_t N = 1 << 20;
+  constexpr std::size_t PIN = 4099;
+  constexpr int ROUNDS = 20;
+  hierarchical_bitmap<MM> b(N);
+  std::vector<std::size_t> pinned;
+  for (std::size_t i = 0; i < N; i += PIN) {
+    b.set(i);
+    pinned.push_back(i);
+  }
+
+  unsigned long finished = 0;
+  test::run_threads(THREADS + 1, [&](unsigned t) {
+    if (t == THREADS) {
+      while (load(finished, rc) < THREADS) {
+        std::size_t k = 0;
+        for (auto i = b.first(0, N); i < N; i = b.next(i, N)) {
+          ATOMIC_OPS_CHECK(k == pinned.size() || pinned[k] >= i);
+          k += (k < pinned.size() && pinned[k] == i);
+        }
+        ATOMIC_OPS_CHECK(k == pinned.size());
+      }
+      return;
+    }
+    for (int r = 0; r < ROUNDS; ++r) {
+      for (std::size_t i = t + 1; i < N; i += 97 * THREADS) {
+        if (i % PIN) {
+          b.set(i);
+        }
+      }
+      for (std::size_t i = t + 1; i < N; i += 97 * THREADS) {
+        if (i % PIN) {
+          b.clear(i);
+        }
+      }
+    }
+    fetch_add(finished, 1ul, rc);
+  });
+
+  std::size_t k = 0;
+  for (auto i = b.first(0, N); i < N; i = b.next(i, N)) {
+    ATOMIC_OPS_CHECK(k < pinned.size() && pinned[k++] == i);
+  }
+  ATOMIC_OPS_CHECK(k == pinned.size());
+}
+
+// Threads set bits in words that other threads are also filling, and each
+// scan that follows its own set() must find the bit, however far the other
+// threads have got with propagating their summary bits.
+template <MemoryModel MM>
+static void set_then_scan() {
+  constexpr std::size_t N = 1 << 22;
+  constexpr int ROUNDS = 5000;
+  for (int trial = 0; trial < 4; ++trial) {
+    hierarchical_bitmap<MM> b(N);
+    test::run_threads(THREADS, [&](unsigned t) {
+      for (int r = 0; r < ROUNDS; ++r) {
+        std::size_t i = ((std::size_t(r) * 2654435761u) % (N / THREADS)) *
+                            THREADS + t;
+        b.set(i);
+        ATOMIC_OPS_CHECK(b.first(0, N) <= i);
+        ATOMIC_OPS_CHECK(b.first(i & ~std::size_t(4095), N) <= i);
+      }
+    });
+  }
+}
+
+int main() {
+  sequential<SequentialConsistency>();
+  sequential<ReleaseConsistency>();
+  sequential<RelaxedConsistency>();
+  sequential<Unsynchronized>();
+  racing<SequentialConsistency>();
+  racing<ReleaseConsistency>();
+  racing<RelaxedConsistency>();
+  set_then_scan<SequentialConsistency>();
+  set_then_scan<ReleaseConsistency>();
+  set_then_scan<RelaxedConsistency>();
+}
@@ -0,0 +1,129 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include <atomic_ops/lock.hpp>
+#include <cstddef>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+#include "test.hpp"
+
+using namespace atomic_ops;
+using atomic_ops::test::THREADS;
+
+static constexpr int ROUNDS = 20000;
+
+// Threads increment a plain counter under the lock, and an owner flag checks
+// that nobody else is inside. Any overlap loses increments or trips the flag.
+template <typename Lock>
+static void exclusion() {
+  Lock l;
+  ATOMIC_OPS_CHECK(l.try_lock());
+  ATOMIC_OPS_CHECK(!l.try_lock());
+  l.unlock();
+
+  unsigned long inside = 0;
+  unsigned long count = 0;
+  test::run_threads(THREADS, [&](unsigned) {
+    for (int r = 0; r < ROUNDS; ++r) {
+      std::lock_guard g(l);
+      ATOMIC_OPS_CHECK(exchange(inside, 1ul, rc) == 0);
+      ++count;
+      ATOMIC_OPS_CHECK(exchange(inside, 0ul, rc) == 1);
+    }
+  });
+  ATOMIC_OPS_CHECK(count == THREADS * ROUNDS);
+}
+
+// Writers hold the lock exclusively while readers share it, and each reader
+// checks that no writer is inside and that the value it reads is stable.
+static void readers_writers() {
+  rw_spinlock l;
+  l.lock_shared();
+  ATOMIC_OPS_CHECK(l.try_lock_shared());
+  ATOMIC_OPS_CHECK(!l.try_lock());
+  l.unlock_shared();
+  l.unlock_shared();
+  ATOMIC_OPS_CHECK(l.try_lock());
+  ATOMIC_OPS_CHECK(!l.try_lock_shared());
+  l.unlock();
+
+  constexpr unsigned WRITERS = 2;
+  unsigned long writers = 0;
+  unsigned long count = 0;
+  test::run_threads(THREADS, [&](unsigned t) {
+    for (int r = 0; r < ROUNDS; ++r) {
+      if (t < WRITERS) {
+        std::lock_guard g(l);
+        ATOMIC_OPS_CHECK(exchange(writers, 1ul, rc) == 0);
+        ++count;
+        ATOMIC_OPS_CHECK(exchange(writers, 0ul, rc) == 1);
+      } else {
+        std::shared_lock g(l);
+        ATOMIC_OPS_CHECK(load(writers, rc) == 0);
+        auto c = count;
+        ATOMIC_OPS_CHECK(load(writers, rc) == 0 && count == c);
+      }
+    }
+  });
+  ATOMIC_OPS_CHECK(count == WRITERS * ROUNDS);
+}
+
+// Each thread increments plain per-word counters under the word's stripe.
+static void striped() {
+  striped_lock<> s(5);
+  ATOMIC_OPS_CHECK(s.size() == 8);
+  ATOMIC_OPS_CHECK(&s.for_word(3) == &s.for_word(11));
+  ATOMIC_OPS_CHECK(&s.for_bit(3 * BITMAP_WORD_BITS + 7) == &s.for_word(3));
+  ATOMIC_OPS_CHECK(&s[9] == &s.for_word(1));
+
+  constexpr std::size_t WORDS = 32;
+  std::vector<unsigned long> counts(WORDS);
+  test::run_threads(THREADS, [&](unsigned t) {
+    for (int r = 0; r < ROUNDS; ++r) {
+      std::size_t w = (t + r * 7) % WORDS;
+      std::lock_guard g(s.for_word(w));
+      ++counts[w];
+    }
+  });
+  unsigned long total = 0;
+  for (auto c : counts) {
+    total += c;
+  }
+  ATOMIC_OPS_CHECK(total == THREADS * ROUNDS);
+}
+
+int main() {
+  exclusion<spinlock>();
+  exclusion<ticket_lock>();
+  exclusion<rw_spinlock>();
+  readers_writers();
+  striped();
+}
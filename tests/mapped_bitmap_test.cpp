@@ -0,0 +1,180 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include <atomic_ops/mapped_bitmap.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <string>
+#include "test.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace atomic_ops;
+namespace fs = std::filesystem;
+
+static constexpr std::size_t N = 100000;
+
+static const std::size_t BITS[] = {0, 1, 63, 64, 65, 4095, 4096, N - 1};
+
+// Open the file at `path`, and return the message of the exception that this
+// throws, or an empty string if it opens.
+static std::string open_error(const fs::path& path, std::size_t n = 0,
+                              bool verify = false) {
+  try {
+    mapped_bitmap<> b(path.c_str(), n, verify);
+  }
+  catch (const std::exception& e) {
+    return e.what();
+  }
+  return "";
+}
+
+// Overwrite `n` bytes of the file at `offset`, behind the mapping's back.
+static void poke(const fs::path& path, std::size_t offset, const void* p,
+                 std::size_t n) {
+  int fd = open(path.c_str(), O_WRONLY);
+  ATOMIC_OPS_CHECK(fd >= 0);
+  ATOMIC_OPS_CHECK(pwrite(fd, p, n, offset) == ssize_t(n));
+  close(fd);
+}
+
+// Change the header of the file with `f` and give it a valid checksum, so that
+// the checks after the checksum are reached.
+template <typename F>
+static void edit_header(const fs::path& path, F&& f) {
+  mapped_bitmap_header h;
+  int fd = open(path.c_str(), O_RDONLY);
+  ATOMIC_OPS_CHECK(fd >= 0);
+  ATOMIC_OPS_CHECK(pread(fd, &h, sizeof(h), 0) == ssize_t(sizeof(h)));
+  close(fd);
+  f(h);
+  h.header_checksum = mapped_header_checksum(h);
+  poke(path, 0, &h, sizeof(h));
+}
+
+static void anonymous() {
+  mapped_bitmap<> b(N);
+  ATOMIC_OPS_CHECK(b.size() == N && b.first() == N);
+  for (auto i : BITS) {
+    ATOMIC_OPS_CHECK(!b.set(i) && b.set(i) && b.get(i));
+  }
+  std::size_t k = 0;
+  for (auto i = b.first(); i < N; i = b.next(i)) {
+    ATOMIC_OPS_CHECK(i == BITS[k++]);
+  }
+  ATOMIC_OPS_CHECK(k == std::size(BITS));
+  ATOMIC_OPS_CHECK(b.clear(64) && !b.get(64));
+  b.flush();
+  b.seal();
+  ATOMIC_OPS_CHECK(!b.clean());
+}
+
+// Create a file, write it, seal it, and reopen it, checking that the bits and
+// the checksum survive, that a reopen unseals, and that a corrupt word, a
+// corrupt header, a different size and a truncated file are each rejected.
+static void file(const fs::path& path) {
+  fs::remove(path);
+  ATOMIC_OPS_CHECK(open_error(path) == "new bitmap file needs a size");
+  ATOMIC_OPS_CHECK(!fs::exists(path));
+
+  unsigned long word = 0;
+  std::uint64_t sum;
+  {
+    mapped_bitmap<> b(path.c_str(), N);
+    ATOMIC_OPS_CHECK(b.size() == N && !b.clean() && b.first() == N);
+    for (auto i : BITS) {
+      b.set(i);
+    }
+    b.flush(60, 70);
+    b.seal();
+    ATOMIC_OPS_CHECK(b.clean());
+    sum = b.checksum();
+  }
+  ATOMIC_OPS_CHECK(fs::file_size(path) == MAPPED_DATA_OFFSET +
+                                               bitmap_words(N) * sizeof(word));
+
+  {
+    mapped_bitmap<> b(path.c_str(), 0, true);
+    ATOMIC_OPS_CHECK(b.size() == N && b.clean());
+    ATOMIC_OPS_CHECK(b.checksum() == sum);
+    std::size_t k = 0;
+    for (auto i = b.first(); i < N; i = b.next(i)) {
+      ATOMIC_OPS_CHECK(i == BITS[k++]);
+    }
+    ATOMIC_OPS_CHECK(k == std::size(BITS));
+    b.clear(4096);
+  }
+
+  {
+    // The last open unsealed the file and was not sealed again, and its
+    // clear reached the file when it was unmapped.
+    mapped_bitmap<> b(path.c_str(), N, true);
+    ATOMIC_OPS_CHECK(!b.clean());
+    ATOMIC_OPS_CHECK(!b.get(4096) && b.get(4095));
+    b.set(4096);
+    b.seal();
+    ATOMIC_OPS_CHECK(b.checksum() == sum);
+  }
+
+  word = ~0ul;
+  poke(path, MAPPED_DATA_OFFSET + 8 * sizeof(word), &word, sizeof(word));
+  ATOMIC_OPS_CHECK(open_error(path, 0, true) ==
+                   "bitmap file checksum mismatch");
+  {
+    // Without verify the corrupt file opens, and is still reported clean.
+    mapped_bitmap<> b(path.c_str());
+    ATOMIC_OPS_CHECK(b.clean() && b.checksum() != sum);
+  }
+  ATOMIC_OPS_CHECK(open_error(path, N - 1) ==
+                   "bitmap file has a different size");
+
+  edit_header(path, [](auto& h) { h.bits = 2 * N; });
+  ATOMIC_OPS_CHECK(open_error(path) == "bitmap file is truncated");
+  edit_header(path, [](auto& h) { h.word_bits = 16; });
+  ATOMIC_OPS_CHECK(open_error(path) ==
+                   "bitmap file has a different word width");
+  std::uint32_t version = 2;
+  poke(path, offsetof(mapped_bitmap_header, version), &version,
+       sizeof(version));
+  ATOMIC_OPS_CHECK(open_error(path) == "invalid bitmap file header");
+
+  fs::resize_file(path, MAPPED_DATA_OFFSET / 2);
+  ATOMIC_OPS_CHECK(open_error(path) == "bitmap file is truncated");
+  fs::remove(path);
+}
+
+int main() {
+  anonymous();
+  file(fs::temp_directory_path() /
+       ("atomic_ops_mapped_bitmap_test." + std::to_string(getpid())));
+}
@@ -0,0 +1,151 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include <atomic_ops/mpmc_queue.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "test.hpp"
+
+using namespace atomic_ops;
+
+static constexpr unsigned PRODUCERS = 4;
+static constexpr unsigned CONSUMERS = 4;
+static constexpr std::uint64_t PER_PRODUCER = 50000;
+static constexpr std::size_t BATCH = 7;
+
+static std::uint64_t item(unsigned p, std::uint64_t i) {
+  return std::uint64_t(p) << 32 | i;
+}
+
+static void single_threaded() {
+  mpmc_queue<int, Unsynchronized> q(5);
+  ATOMIC_OPS_CHECK(q.capacity() == 8);
+  int out;
+  ATOMIC_OPS_CHECK(!q.try_pop(out));
+  int in[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  ATOMIC_OPS_CHECK(q.try_push_n(in, 10) == 8);
+  ATOMIC_OPS_CHECK(!q.try_push(10));
+  int got[10] = {};
+  ATOMIC_OPS_CHECK(q.try_pop_n(got, 3) == 3);
+  ATOMIC_OPS_CHECK(got[0] == 0 && got[1] == 1 && got[2] == 2);
+  ATOMIC_OPS_CHECK(q.try_push(8));
+  ATOMIC_OPS_CHECK(q.try_pop_n(got, 10) == 6);
+  for (int i = 0; i < 6; ++i) {
+    ATOMIC_OPS_CHECK(got[i] == i + 3);
+  }
+  ATOMIC_OPS_CHECK(q.try_pop_n(got, 10) == 0);
+}
+
+// Producers push tagged sequence numbers in batches and consumers pop them in
+// batches. Every item must be popped exactly once, and the items of each
+// producer must reach each consumer in the order in which they were pushed.
+template <MemoryModel MM>
+static void batches() {
+  mpmc_queue<std::uint64_t, MM> q(64);
+  std::vector<unsigned char> seen(PRODUCERS * PER_PRODUCER);
+  unsigned long popped = 0;
+
+  test::run_threads(PRODUCERS + CONSUMERS, [&](unsigned t) {
+    if (t < PRODUCERS) {
+      std::uint64_t batch[BATCH];
+      for (std::uint64_t i = 0; i < PER_PRODUCER;) {
+        std::size_t n = 0;
+        for (; n < BATCH && i + n < PER_PRODUCER; ++n) {
+          batch[n] = item(t, i + n);
+        }
+        if (auto k = q.try_push_n(batch, n)) {
+          i += k;
+        }
+        else {
+          std::this_thread::yield();
+        }
+      }
+      return;
+    }
+    std::uint64_t last[PRODUCERS] = {};
+    bool any[PRODUCERS] = {};
+    std::uint64_t batch[BATCH];
+    while (load(popped, rc) < PRODUCERS * PER_PRODUCER) {
+      std::size_t n = q.try_pop_n(batch, BATCH);
+      if (n == 0) {
+        std::this_thread::yield();
+      }
+      for (std::size_t j = 0; j < n; ++j) {
+        unsigned p = batch[j] >> 32;
+        std::uint64_t i = batch[j] & 0xffffffff;
+        ATOMIC_OPS_CHECK(p < PRODUCERS && i < PER_PRODUCER);
+        ATOMIC_OPS_CHECK(!any[p] || last[p] < i);
+        any[p] = true;
+        last[p] = i;
+        ATOMIC_OPS_CHECK(seen[p * PER_PRODUCER + i]++ == 0);
+      }
+      fetch_add(popped, n, rc);
+    }
+  });
+
+  for (auto s : seen) {
+    ATOMIC_OPS_CHECK(s == 1);
+  }
+  std::uint64_t out;
+  ATOMIC_OPS_CHECK(!q.try_pop(out));
+}
+
+// The blocking queue parks producers on a full queue and consumers on an empty
+// one, so a small capacity exercises both waits.
+static void blocking() {
+  mpmc_queue<std::uint64_t, ReleaseConsistency, true> q(2);
+  std::vector<unsigned long> sums(CONSUMERS);
+  test::run_threads(PRODUCERS + CONSUMERS, [&](unsigned t) {
+    if (t < PRODUCERS) {
+      for (std::uint64_t i = 1; i <= PER_PRODUCER / 10; ++i) {
+        q.push(i);
+      }
+      return;
+    }
+    for (std::uint64_t i = 0; i < PER_PRODUCER / 10; ++i) {
+      sums[t - PRODUCERS] += q.pop();
+    }
+  });
+  unsigned long sum = 0;
+  for (auto s : sums) {
+    sum += s;
+  }
+  std::uint64_t n = PER_PRODUCER / 10;
+  ATOMIC_OPS_CHECK(sum == PRODUCERS * n * (n + 1) / 2);
+}
+
+int main() {
+  single_threaded();
+  batches<ReleaseConsistency>();
+  batches<SequentialConsistency>();
+  blocking();
+}
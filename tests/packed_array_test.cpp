@@ -0,0 +1,143 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include <atomic_ops/packed_array.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "test.hpp"
+
+using namespace atomic_ops;
+using atomic_ops::test::THREADS;
+
+// Update the fields on either side of each word boundary with every operation,
+// and check the returned values and every field of the array against a plain
+// vector after each update, so that a wrong shift or mask that touches a
+// neighbouring field, or the next word, is caught.
+template <int Bits, typename Word, MemoryModel MM>
+static void boundaries() {
+  using array = packed_array<Bits, Word, MM>;
+  constexpr std::size_t FIELDS = bitmap_word_bits<Word> / Bits;
+  constexpr std::size_t N = 3 * FIELDS + 1;
+  constexpr Word MAX = array::MAX;
+  ATOMIC_OPS_CHECK(MAX == Word(~Word(0) >> (bitmap_word_bits<Word> - Bits)));
+
+  array a(N);
+  std::vector<Word> ref(N);
+  auto check = [&] {
+    for (std::size_t i = 0; i < N; ++i) {
+      ATOMIC_OPS_CHECK(a.get(i) == ref[i]);
+    }
+  };
+  ATOMIC_OPS_CHECK(a.size() == N);
+  check();
+
+  std::vector<std::size_t> edges = {0, N - 1};
+  for (std::size_t b = FIELDS; b < N; b += FIELDS) {
+    edges.push_back(b - 1);
+    edges.push_back(b);
+  }
+
+  const Word values[] = {MAX, 0, Word(MAX / 3), Word(MAX - 1), 1};
+  for (auto i : edges) {
+    for (auto v : values) {
+      ATOMIC_OPS_CHECK(a.set(i, v) == ref[i]);
+      ref[i] = v;
+      check();
+    }
+
+    Word expected = Word(ref[i] ^ 1);
+    ATOMIC_OPS_CHECK(!a.cas(i, expected, 0));
+    ATOMIC_OPS_CHECK(expected == ref[i]);
+    check();
+    ATOMIC_OPS_CHECK(a.cas(i, expected, MAX));
+    ref[i] = MAX;
+    check();
+
+    ATOMIC_OPS_CHECK(a.fetch_and(i, Word(MAX / 3)) == MAX);
+    ref[i] = MAX / 3;
+    check();
+    ATOMIC_OPS_CHECK(a.fetch_or(i, Word(MAX - MAX / 3)) == MAX / 3);
+    ref[i] = MAX;
+    check();
+
+    // The bits of a value wider than the field are dropped.
+    ATOMIC_OPS_CHECK(a.set(i, Word(~Word(0) ^ 1)) == MAX);
+    ref[i] = Word(MAX ^ 1);
+    check();
+  }
+}
+
+// The threads own interleaved fields, so that neighbouring fields in a word
+// belong to different threads, and count them up with cas(), which retries
+// when a neighbour changes the word. No increment may be lost or leak into
+// another field.
+template <int Bits, typename Word>
+static void neighbours() {
+  using array = packed_array<Bits, Word>;
+  constexpr std::size_t FIELDS = bitmap_word_bits<Word> / Bits;
+  constexpr std::size_t N = 4 * FIELDS;
+  constexpr Word MAX = array::MAX;
+  constexpr int ROUNDS = 1000;
+  array a(N);
+  test::run_threads(THREADS, [&](unsigned t) {
+    for (int r = 0; r < ROUNDS; ++r) {
+      for (std::size_t i = t; i < N; i += THREADS) {
+        Word v = a.get(i);
+        while (!a.cas(i, v, Word((v + 1) & MAX))) {
+        }
+      }
+    }
+  });
+  for (std::size_t i = 0; i < N; ++i) {
+    ATOMIC_OPS_CHECK(a.get(i) == (Word(ROUNDS) & MAX));
+  }
+}
+
+template <int Bits, typename Word>
+static void all_models() {
+  boundaries<Bits, Word, SequentialConsistency>();
+  boundaries<Bits, Word, ReleaseConsistency>();
+  boundaries<Bits, Word, RelaxedConsistency>();
+  boundaries<Bits, Word, Unsynchronized>();
+}
+
+int main() {
+  all_models<1, unsigned long>();
+  all_models<2, unsigned long>();
+  all_models<4, std::uint32_t>();
+  all_models<8, std::uint64_t>();
+  all_models<16, std::uint32_t>();
+  all_models<32, std::uint32_t>();
+  all_models<64, unsigned long>();
+  neighbours<2, unsigned long>();
+  neighbours<4, std::uint32_t>();
+  neighbours<16, std::uint64_t>();
+}
@@ -0,0 +1,89 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include <atomic_ops/phase.hpp>
+#include <cstddef>
+#include <vector>
+#include "test.hpp"
+
+using namespace atomic_ops;
+using atomic_ops::test::THREADS;
+
+static constexpr unsigned PHASES = 1000;
+
+// A barrier for one thread completes a phase on every arrival.
+static void single() {
+  phase_barrier barrier(1);
+  ATOMIC_OPS_CHECK(barrier.size() == 1 && barrier.phase() == 0);
+  for (unsigned p = 0; p < 10; ++p) {
+    ATOMIC_OPS_CHECK(barrier.arrive_and_wait());
+    ATOMIC_OPS_CHECK(barrier.phase() == p + 1);
+  }
+}
+
+// The threads reuse one barrier for many phases. In each phase every thread
+// writes its slot of one of two buffers with the phase model, and after the
+// barrier reads every slot that the others wrote, while they are already
+// writing the other buffer in the next phase. Exactly one thread must lead
+// each phase, and phase() must be exact between barriers.
+template <MemoryModel MM>
+static void reuse() {
+  phase_barrier barrier(THREADS);
+  std::vector<unsigned long> slots[2] = {std::vector<unsigned long>(THREADS),
+                                         std::vector<unsigned long>(THREADS)};
+  std::vector<unsigned> leaders(PHASES);
+  test::run_threads(THREADS, [&](unsigned t) {
+    for (unsigned p = 0; p < PHASES; ++p) {
+      auto& buffer = slots[p % 2];
+      bool leader = with_phase<MM>(barrier, [&](auto mm) {
+        store(buffer[t], p + 1ul, mm);
+      });
+      if (leader) {
+        fetch_add(leaders[p], 1u, rc);
+      }
+      ATOMIC_OPS_CHECK(barrier.phase() == p + 1);
+      for (unsigned u = 0; u < THREADS; ++u) {
+        ATOMIC_OPS_CHECK(load(buffer[u], xc) == p + 1);
+      }
+    }
+  });
+  ATOMIC_OPS_CHECK(barrier.phase() == PHASES);
+  for (auto n : leaders) {
+    ATOMIC_OPS_CHECK(n == 1);
+  }
+}
+
+int main() {
+  single();
+  reuse<SequentialConsistency>();
+  reuse<ReleaseConsistency>();
+  reuse<RelaxedConsistency>();
+  reuse<Unsynchronized>();
+}
@@ -0,0 +1,207 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include <atomic_ops/reclaim.hpp>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "test.hpp"
+
+using namespace atomic_ops;
+using atomic_ops::test::THREADS;
+
+static constexpr std::size_t SWAPS = 20000;
+static constexpr unsigned WRITERS = 2;
+
+struct node {
+  std::size_t id;
+  node* next = nullptr;
+};
+
+// The freed flag of each node, which its deleter sets before deleting it, so
+// that a reader can check that a node it protects has not been freed.
+static std::vector<unsigned long> freed;
+static unsigned long frees = 0;
+
+static void free_node(void* p) {
+  auto* n = static_cast<node*>(p);
+  ATOMIC_OPS_CHECK(exchange(freed[n->id], 1ul, rc) == 0);
+  fetch_add(frees, 1ul, rc);
+  delete n;
+}
+
+// Writers replace the shared node and retire the old one, while readers load
+// and use the current node inside a read-side section. Every retired node must
+// be freed exactly once, and never while a reader can still see it.
+template <typename Domain, typename Read>
+static void run(Read&& read) {
+  freed.assign(WRITERS * SWAPS + 1, 0);
+  frees = 0;
+  node* shared = new node{0};
+  unsigned long next = 1;
+  unsigned long writers_done = 0;
+  {
+    Domain d;
+    test::run_threads(THREADS, [&](unsigned t) {
+      typename Domain::participant p(d);
+      if (t < WRITERS) {
+        for (std::size_t i = 0; i < SWAPS; ++i) {
+          auto* n = new node{fetch_add(next, 1ul, rc)};
+          p.retire(exchange(shared, n, rc), free_node);
+        }
+        fetch_add(writers_done, 1ul, rc);
+        return;
+      }
+      while (load(writers_done, rc) < WRITERS) {
+        read(p, shared);
+      }
+    });
+    ATOMIC_OPS_CHECK(load(frees, rc) <= WRITERS * SWAPS);
+  }
+  ATOMIC_OPS_CHECK(frees == WRITERS * SWAPS);
+  ATOMIC_OPS_CHECK(freed[shared->id] == 0);
+  delete shared;
+}
+
+static void epoch() {
+  run<epoch_domain>([](epoch_domain::participant& p, node*& shared) {
+    epoch_domain::guard g(p);
+    node* n = load(shared, rc);
+    ATOMIC_OPS_CHECK(load(freed[n->id], rc) == 0);
+  });
+}
+
+static void hazard() {
+  run<hazard_domain>([](hazard_domain::participant& p, node*& shared) {
+    node* n = p.protect(0, shared);
+    ATOMIC_OPS_CHECK(load(freed[n->id], rc) == 0);
+    p.clear(0);
+  });
+}
+
+// Each writer owns a list, and unlinks the node after its head and pushes a
+// new head, retiring the unlinked node. Readers walk every list under a guard
+// and check that none of the nodes they reach has been freed, which fails if
+// a node is tagged with an epoch older than the unlink.
+static void epoch_lists() {
+  constexpr std::size_t LENGTH = 8;
+  freed.assign(WRITERS * (SWAPS + LENGTH), 0);
+  frees = 0;
+  unsigned long next = 0;
+  node* heads[WRITERS];
+  for (auto& h : heads) {
+    h = nullptr;
+    for (std::size_t i = 0; i < LENGTH; ++i) {
+      h = new node{next++, h};
+    }
+  }
+  unsigned long writers_done = 0;
+  {
+    epoch_domain d;
+    test::run_threads(THREADS, [&](unsigned t) {
+      epoch_domain::participant p(d);
+      if (t < WRITERS) {
+        node*& head = heads[t];
+        for (std::size_t i = 0; i < SWAPS; ++i) {
+          node* h = load(head, rc);
+          node* victim = load(h->next, rc);
+          store(h->next, load(victim->next, rc), rc);
+          store(head, new node{fetch_add(next, 1ul, rc), h}, rc);
+          p.retire(victim, free_node);
+        }
+        fetch_add(writers_done, 1ul, rc);
+        return;
+      }
+      while (load(writers_done, rc) < WRITERS) {
+        epoch_domain::guard g(p);
+        for (auto& head : heads) {
+          for (node* n = load(head, rc); n; n = load(n->next, rc)) {
+            ATOMIC_OPS_CHECK(load(freed[n->id], rc) == 0);
+          }
+        }
+      }
+    });
+  }
+  ATOMIC_OPS_CHECK(frees == WRITERS * SWAPS);
+  for (auto h : heads) {
+    std::size_t k = 0;
+    while (h) {
+      ATOMIC_OPS_CHECK(freed[h->id] == 0);
+      delete std::exchange(h, h->next);
+      ++k;
+    }
+    ATOMIC_OPS_CHECK(k == LENGTH);
+  }
+}
+
+// A node that is protected must survive reclaim(), and be freed by the first
+// reclaim() after it is released.
+static void hazard_protects() {
+  freed.assign(1, 0);
+  frees = 0;
+  hazard_domain d;
+  hazard_domain::participant reader(d), writer(d);
+  node* shared = new node{0};
+  node* n = reader.protect(1, shared);
+  shared = nullptr;
+  writer.retire(n, free_node);
+  writer.reclaim();
+  ATOMIC_OPS_CHECK(frees == 0);
+  reader.clear(1);
+  writer.reclaim();
+  ATOMIC_OPS_CHECK(frees == 1);
+}
+
+// A node retired while a reader is active must outlive the reader's section.
+static void epoch_protects() {
+  freed.assign(1, 0);
+  frees = 0;
+  epoch_domain d;
+  epoch_domain::participant reader(d), writer(d);
+  reader.enter();
+  writer.retire(new node{0}, free_node);
+  for (int i = 0; i < 4; ++i) {
+    writer.reclaim();
+  }
+  ATOMIC_OPS_CHECK(frees == 0);
+  reader.exit();
+  for (int i = 0; i < 4; ++i) {
+    writer.reclaim();
+  }
+  ATOMIC_OPS_CHECK(frees == 1);
+}
+
+int main() {
+  epoch_protects();
+  hazard_protects();
+  epoch();
+  epoch_lists();
+  hazard();
+}
@@ -0,0 +1,105 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include <atomic_ops/static_bitmap.hpp>
+#include <cstddef>
+#include "test.hpp"
+
+using namespace atomic_ops;
+using atomic_ops::test::THREADS;
+
+// Fill the bitmap one bit at a time, so that all() must stay false until the
+// last bit of the partial last word is set, and then empty it again.
+template <std::size_t N, MemoryModel MM>
+static void fill() {
+  static_bitmap<N, MM> b;
+  ATOMIC_OPS_CHECK(b.none() && !b.any() && !b.all());
+  ATOMIC_OPS_CHECK(b.first() == N);
+  for (std::size_t i = 0; i < N; ++i) {
+    ATOMIC_OPS_CHECK(!b.all());
+    ATOMIC_OPS_CHECK(!b.set(i));
+    ATOMIC_OPS_CHECK(b.set(i));
+    ATOMIC_OPS_CHECK(b.count() == i + 1);
+    ATOMIC_OPS_CHECK(b.first() == 0);
+  }
+  ATOMIC_OPS_CHECK(b.all() && b.any());
+  ATOMIC_OPS_CHECK(b.next(N - 1) == N);
+
+  // Clearing any one bit, including the last, must make all() false.
+  for (std::size_t i : {std::size_t(0), N / 2, N - 1}) {
+    ATOMIC_OPS_CHECK(b.clear(i));
+    ATOMIC_OPS_CHECK(!b.all() && b.count() == N - 1);
+    ATOMIC_OPS_CHECK(b.first(i) == ((i + 1 < N) ? i + 1 : N));
+    ATOMIC_OPS_CHECK(!b.set(i));
+    ATOMIC_OPS_CHECK(b.all());
+  }
+
+  b.reset();
+  ATOMIC_OPS_CHECK(b.none() && b.count() == 0);
+  for (std::size_t i = 0; i < N; i += 3) {
+    b.set(i);
+  }
+  std::size_t n = 0;
+  for (auto i = b.first(); i < N; i = b.next(i)) {
+    ATOMIC_OPS_CHECK(i == 3 * n++);
+  }
+  ATOMIC_OPS_CHECK(n == (N + 2) / 3);
+}
+
+template <std::size_t N>
+static void fill_models() {
+  fill<N, SequentialConsistency>();
+  fill<N, ReleaseConsistency>();
+  fill<N, RelaxedConsistency>();
+  fill<N, Unsynchronized>();
+}
+
+// The threads set disjoint strides of the same words, so every set races with
+// the others on its word, and none of them may be lost.
+static void concurrent() {
+  constexpr std::size_t N = 1000;
+  static_bitmap<N> b;
+  test::run_threads(THREADS, [&](unsigned t) {
+    for (std::size_t i = t; i < N; i += THREADS) {
+      ATOMIC_OPS_CHECK(!b.set(i));
+    }
+  });
+  ATOMIC_OPS_CHECK(b.all() && b.count() == N);
+}
+
+int main() {
+  fill_models<1>();
+  fill_models<63>();
+  fill_models<64>();
+  fill_models<65>();
+  fill_models<127>();
+  fill_models<1000>();
+  concurrent();
+}
@@ -0,0 +1,126 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include <atomic_ops/versioned_bitmap.hpp>
+#include <cstddef>
+#include <vector>
+#include "test.hpp"
+
+using namespace atomic_ops;
+
+static constexpr std::size_t BLOCK_WORDS = 8;
+static constexpr std::size_t BLOCK_BITS = BLOCK_WORDS * BITMAP_WORD_BITS;
+static constexpr unsigned WRITERS = 4;
+static constexpr unsigned READERS = 4;
+static constexpr int ROUNDS = 200;
+
+template <MemoryModel MM>
+static void sequential() {
+  constexpr std::size_t N = 1000;
+  versioned_bitmap<MM, BLOCK_WORDS> b(N);
+  ATOMIC_OPS_CHECK(b.size() == N);
+  ATOMIC_OPS_CHECK(b.first() == N);
+
+  std::size_t bits[] = {0, 63, 64, 255, 256, 700, N - 1};
+  for (auto i : bits) {
+    ATOMIC_OPS_CHECK(!b.set(i));
+    ATOMIC_OPS_CHECK(b.set(i));
+    ATOMIC_OPS_CHECK(b.get(i));
+  }
+  std::size_t k = 0;
+  for (auto i = b.first(); i < N; i = b.next(i)) {
+    ATOMIC_OPS_CHECK(i == bits[k++]);
+  }
+  ATOMIC_OPS_CHECK(k == std::size(bits));
+
+  std::vector<unsigned long> out((N - 1) / BITMAP_WORD_BITS + 1, ~0ul);
+  b.snapshot(64, 700, out.data());
+  ATOMIC_OPS_CHECK(out[0] == ~0ul);
+  for (std::size_t i = 64; i < 700; ++i) {
+    ATOMIC_OPS_CHECK(bitmap_get(out.data(), i, unsync) == b.get(i));
+  }
+
+  for (auto i : bits) {
+    ATOMIC_OPS_CHECK(b.clear(i));
+    ATOMIC_OPS_CHECK(!b.clear(i));
+  }
+  ATOMIC_OPS_CHECK(b.first() == N);
+}
+
+// Each writer owns a block and sets its bits in order and then clears them in
+// order, so every state that the block passes through is a run of ones
+// followed by a run of zeros or the reverse. A torn copy, one that mixes words
+// from before and after a write, breaks the pattern, so every block of every
+// snapshot can be checked on its own.
+template <MemoryModel MM>
+static void snapshots() {
+  constexpr std::size_t N = WRITERS * BLOCK_BITS - 5;
+  versioned_bitmap<MM, BLOCK_WORDS> b(N);
+  unsigned long finished = 0;
+
+  test::run_threads(WRITERS + READERS, [&](unsigned t) {
+    if (t < WRITERS) {
+      std::size_t e = (t + 1) * BLOCK_BITS < N ? (t + 1) * BLOCK_BITS : N;
+      for (int r = 0; r < ROUNDS; ++r) {
+        for (std::size_t i = t * BLOCK_BITS; i < e; ++i) {
+          b.set(i);
+        }
+        for (std::size_t i = t * BLOCK_BITS; i < e; ++i) {
+          b.clear(i);
+        }
+      }
+      fetch_add(finished, 1ul, rc);
+      return;
+    }
+    std::vector<unsigned long> out(WRITERS * BLOCK_WORDS);
+    while (load(finished, rc) < WRITERS) {
+      b.snapshot(0, N, out.data());
+      for (std::size_t i = 0; i < N; i += BLOCK_BITS) {
+        std::size_t e = i + BLOCK_BITS < N ? i + BLOCK_BITS : N;
+        std::size_t changes = 0;
+        for (std::size_t k = i + 1; k < e; ++k) {
+          changes += !bitmap_get(out.data(), k, unsync) !=
+                     !bitmap_get(out.data(), k - 1, unsync);
+        }
+        ATOMIC_OPS_CHECK(changes <= 1);
+      }
+    }
+  });
+  ATOMIC_OPS_CHECK(b.first() == N);
+}
+
+int main() {
+  sequential<SequentialConsistency>();
+  sequential<ReleaseConsistency>();
+  sequential<RelaxedConsistency>();
+  snapshots<SequentialConsistency>();
+  snapshots<ReleaseConsistency>();
+  snapshots<RelaxedConsistency>();
+}
@@ -0,0 +1,113 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2020, Luke D'Alessandro
+// Copyright (c) 2020, Trustees of Indiana University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include <atomic_ops/wait.hpp>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include "test.hpp"
+
+using namespace atomic_ops;
+using atomic_ops::test::THREADS;
+
+static constexpr unsigned ROUNDS = 2000;
+
+// wait() returns at once when the value has already changed, and `old` may be
+// a literal of a different type than the word.
+static void immediate() {
+  unsigned long a = 1;
+  wait(a, 0, rc);
+  std::uint32_t b = 1;
+  wait(b, 0, sc);
+  unsigned short c = 1;
+  wait(c, 0, xc);
+}
+
+// Two threads take turns on a word, each waiting for the other to hand it
+// over and then notifying it. Each handoff is a wakeup that must not be lost,
+// once the waiter has run out of spins and yields and parks.
+template <typename T>
+static void ping_pong() {
+  T turn = 0;
+  test::run_threads(2, [&](unsigned t) {
+    for (unsigned r = 0; r < ROUNDS; ++r) {
+      T mine = T(2 * r + t);
+      for (T v; (v = load(turn, rc)) != mine;) {
+        wait(turn, v, rc);
+      }
+      store(turn, T(mine + 1), rc);
+      notify_one(turn);
+    }
+  });
+  ATOMIC_OPS_CHECK(turn == T(2 * ROUNDS));
+}
+
+// The other threads wait on a generation number, which the first bumps with
+// notify_all once they have all acknowledged the previous one. The first
+// thread sleeps before some of the bumps, so that the waiters are parked, and
+// every waiter must wake for every generation.
+template <typename T>
+static void broadcast() {
+  constexpr unsigned GENERATIONS = 200;
+  T gen = 0;
+  unsigned acks = 0;
+  test::run_threads(THREADS, [&](unsigned t) {
+    if (t == 0) {
+      for (unsigned g = 1; g <= GENERATIONS; ++g) {
+        for (unsigned a; (a = load(acks, rc)) != (g - 1) * (THREADS - 1);) {
+          wait(acks, a, rc);
+        }
+        if (g % 50 == 0) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        store(gen, T(g), rc);
+        notify_all(gen);
+      }
+      return;
+    }
+    for (unsigned g = 1; g <= GENERATIONS; ++g) {
+      for (T v; (v = load(gen, rc)) != T(g);) {
+        wait(gen, v, rc);
+      }
+      fetch_add(acks, 1u, rc);
+      notify_one(acks);
+    }
+  });
+  ATOMIC_OPS_CHECK(acks == GENERATIONS * (THREADS - 1));
+}
+
+int main() {
+  immediate();
+  ping_pong<unsigned>();
+  ping_pong<unsigned long>();
+  ping_pong<unsigned short>();
+  broadcast<unsigned>();
+  broadcast<unsigned long>();
+}